@@ -0,0 +1,616 @@
+//***********************************************************************
+// k-means-distributed.cpp
+//
+//   this is the distributed mode of the K-means classification algorithm.
+//   a coordinator process and any number of worker processes connect over
+//   TCP or a Unix socket. each worker loads one shard of the input data,
+//   clusters it against the means sent by the coordinator and sends back
+//   only the per-cluster sums and counts. the coordinator merges them into
+//   the new means. seeding uses k-means|| over the workers
+//
+// INVOKE APPLICATION USING: k-means++ <control file name>
+//   with #distributed-role coordinator in the coordinator's control file
+//   and #distributed-role worker in each worker's control file
+//
+// OUTPUTS: (to disk file)
+//        coordinator <output_filename> - the cluster means and the member
+//             counts across all workers, without member listings
+//        worker <output_filename> - the usual results for that worker's
+//             shard, with the final means and the shard's member counts
+//
+//***********************************************************************
+//  WARNING: values are sent in native byte order, so all processes must
+//           run on machines with the same byte order. POSIX only
+//
+//***********************************************************************
+// Copyright 2014 Isaac Brodsky
+//
+//***********************************************************************
+
+#include "k-means-multi.h"
+#include <fstream>
+#include <cfloat>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// messages from the coordinator to a worker
+enum Distributed_command : uint32_t {
+	CMD_COST = 1,	// new seeding candidates -> cost of the shard
+	CMD_SAMPLE,		// total cost, oversampling -> sampled candidates
+	CMD_WEIGHTS,	// -> instances nearest each candidate
+	CMD_FETCH,		// shard index -> the instance
+	CMD_ASSIGN,		// means -> reassigned count, counts and sums
+	CMD_FINISH		// final means -> worker writes its results and exits
+};
+
+//***********************************************************************
+// Socket helpers
+//***********************************************************************
+// Returns a listening (coordinator) or connected (worker) socket, or -1
+int Socket_open(const string& sAddress, bool bListen){
+
+	// local variables
+	int iFd = -1;
+	string sHost, sPort;
+	size_t szColon;
+	struct sockaddr_un saUnix;
+	struct addrinfo aiHints, *paiResult, *paiEntry;
+
+	if (sAddress.compare(0, 5, "unix:") == 0) {
+		// a Unix socket path
+		memset(&saUnix, 0, sizeof(saUnix));
+		saUnix.sun_family = AF_UNIX;
+		strncpy(saUnix.sun_path, sAddress.c_str() + 5, sizeof(saUnix.sun_path) - 1);
+
+		iFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (iFd < 0) return -1;
+		if (bListen) {
+			unlink(saUnix.sun_path); // left over from an earlier run
+			if (bind(iFd, (struct sockaddr*)&saUnix, sizeof(saUnix)) != 0 || listen(iFd, SOMAXCONN) != 0) {
+				close(iFd);
+				return -1;
+			}
+		}
+		else if (connect(iFd, (struct sockaddr*)&saUnix, sizeof(saUnix)) != 0) {
+			close(iFd);
+			return -1;
+		} // if
+		return iFd;
+	} // if
+
+	// a TCP host:port
+	szColon = sAddress.rfind(':');
+	if (szColon == string::npos) return -1;
+	sHost = sAddress.substr(0, szColon);
+	sPort = sAddress.substr(szColon + 1);
+
+	memset(&aiHints, 0, sizeof(aiHints));
+	aiHints.ai_family = AF_UNSPEC;
+	aiHints.ai_socktype = SOCK_STREAM;
+	aiHints.ai_flags = bListen ? AI_PASSIVE : 0;
+	if (getaddrinfo(sHost.empty() ? NULL : sHost.c_str(), sPort.c_str(), &aiHints, &paiResult) != 0) return -1;
+
+	for (paiEntry = paiResult; paiEntry != NULL; paiEntry = paiEntry->ai_next) {
+		iFd = socket(paiEntry->ai_family, paiEntry->ai_socktype, paiEntry->ai_protocol);
+		if (iFd < 0) continue;
+		if (bListen) {
+			int iReuse = 1;
+			setsockopt(iFd, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+			if (bind(iFd, paiEntry->ai_addr, paiEntry->ai_addrlen) == 0 && listen(iFd, SOMAXCONN) == 0) break;
+		}
+		else if (connect(iFd, paiEntry->ai_addr, paiEntry->ai_addrlen) == 0) {
+			break;
+		} // if
+		close(iFd);
+		iFd = -1;
+	} // for
+
+	freeaddrinfo(paiResult);
+	return iFd;
+} // Socket_open
+
+//***********************************************************************
+// Returns true on success
+bool Send_all(int iFd, const void* pvData, size_t szLength){
+
+	const char* pcData = (const char*)pvData;
+	ssize_t ssSent;
+
+	while (szLength > 0) {
+		ssSent = send(iFd, pcData, szLength, MSG_NOSIGNAL);
+		if (ssSent <= 0) return false;
+		pcData += ssSent;
+		szLength -= ssSent;
+	} // while
+
+	return true;
+} // Send_all
+
+//***********************************************************************
+// Returns true on success
+static bool Recv_all(int iFd, void* pvData, size_t szLength){
+
+	char* pcData = (char*)pvData;
+	ssize_t ssReceived;
+
+	while (szLength > 0) {
+		ssReceived = recv(iFd, pcData, szLength, 0);
+		if (ssReceived <= 0) return false;
+		pcData += ssReceived;
+		szLength -= ssReceived;
+	} // while
+
+	return true;
+} // Recv_all
+
+template<class T> static bool Send_value(int iFd, const T& tValue){
+	return Send_all(iFd, &tValue, sizeof(T));
+}
+
+template<class T> static bool Recv_value(int iFd, T& tValue){
+	return Recv_all(iFd, &tValue, sizeof(T));
+}
+
+// the receiver sizes the vector before reading
+template<class T> static bool Send_vector(int iFd, const vector<T>& vtValues){
+	return Send_all(iFd, vtValues.data(), vtValues.size() * sizeof(T));
+}
+
+template<class T> static bool Recv_vector(int iFd, vector<T>& vtValues){
+	return Recv_all(iFd, vtValues.data(), vtValues.size() * sizeof(T));
+}
+
+//***********************************************************************
+// Flattens the means into one k by attribute count vector
+static vector<float> Flatten_means(const vector< vector<float> >& vvfCluster_means){
+
+	vector<float> vfResult;
+
+	for (size_t szK_index = 0; szK_index < vvfCluster_means.size(); szK_index++)
+		vfResult.insert(vfResult.end(), vvfCluster_means[szK_index].begin(), vvfCluster_means[szK_index].end());
+
+	return vfResult;
+} // Flatten_means
+
+//***********************************************************************
+// class Cluster_set distributed method declarations
+//***********************************************************************
+void Cluster_set::Execute_distributed_coordinator(void){
+
+	// local variables
+	int iListen_fd, iWorker_fd;
+	int iWorker_index, iK_index, iAttribute_index;
+	int32_t iWorker_attribute_ct;
+	uint64_t ullWorker_instances, ullWorker_reassigned;
+	bool bNot_done = true;
+	bool bOk = true;
+	vector<int> viWorker_fds;
+	vector<float> vfMeans, vfWorker_sums;
+	vector<uint32_t> vuWorker_counts;
+	vector<double> vdSums;
+	vector<float> vfSums;
+	vector<unsigned> vuCounts;
+	ofstream strResults_out_stream;
+
+	iListen_fd = Socket_open(sDistributed_address, true);
+	if (iListen_fd < 0) {
+		sError = "Error listening on " + sDistributed_address;
+		cout << sError << endl << endl;
+		return;
+	}
+
+	// wait for every worker, and tell each which shard it holds
+	for (iWorker_index = 0; iWorker_index < iDistributed_workers && bOk; iWorker_index++) {
+		iWorker_fd = accept(iListen_fd, NULL, NULL);
+		if (iWorker_fd < 0) {
+			bOk = false;
+			break;
+		}
+		viWorker_fds.push_back(iWorker_fd);
+
+		bOk = Send_value(iWorker_fd, (int32_t)iWorker_index)
+			&& Send_value(iWorker_fd, (int32_t)iDistributed_workers)
+			&& Send_value(iWorker_fd, (int32_t)iK_count);
+	} // for
+
+	// then collect the shard sizes, so the workers read their shards at the same time
+	szInstance_ct = 0;
+	iAttribute_ct = -1;
+	for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+		bOk = Recv_value(viWorker_fds[iWorker_index], ullWorker_instances)
+			&& Recv_value(viWorker_fds[iWorker_index], iWorker_attribute_ct);
+		if (bOk && iAttribute_ct != -1 && iAttribute_ct != iWorker_attribute_ct) {
+			sError = "Worker " + to_string(iWorker_index) + " has a different attribute count.";
+			cout << sError << endl;
+			bOk = false;
+		} // if
+		iAttribute_ct = iWorker_attribute_ct;
+		szInstance_ct += ullWorker_instances;
+	} // for
+	close(iListen_fd);
+	if (sDistributed_address.compare(0, 5, "unix:") == 0) unlink(sDistributed_address.c_str() + 5);
+
+	if (bOk && szInstance_ct < (size_t)iK_count) {
+		sError = "Fewer instances than clusters across the workers.";
+		cout << sError << endl;
+		bOk = false;
+	} // if
+
+	// the time budget starts once the workers have loaded their shards
+	tpClustering_start = chrono::steady_clock::now();
+
+	if (bOk) {
+		Allocate_means();
+
+		// seed the means
+		if (bUsePlusPlus) {
+			bOk = Distributed_plus_plus(viWorker_fds);
+		}
+		else { // Use the first k instances.
+			for (iK_index = 0; iK_index < iK_count && bOk; iK_index++)
+				bOk = Distributed_fetch(viWorker_fds, iK_index, vvfMeans[iK_index]);
+		} // if
+	} // if
+
+	// loop until we are done clustering, as in Execute_clustering
+	while (bOk && bNot_done){
+
+		vvfOld_means = vvfMeans;
+
+		// every worker clusters its shard against the same means
+		vfMeans = Flatten_means(vvfMeans);
+		for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+			bOk = Send_value(viWorker_fds[iWorker_index], (uint32_t)CMD_ASSIGN)
+				&& Send_vector(viWorker_fds[iWorker_index], vfMeans);
+		} // for
+
+		// merge their sums and counts
+		vdSums.assign(iK_count * iAttribute_ct, 0);
+		vuCounts.assign(iK_count, 0);
+		vfWorker_sums.resize(iK_count * iAttribute_ct);
+		vuWorker_counts.resize(iK_count);
+		uReassigned_ct = 0;
+		for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+			bOk = Recv_value(viWorker_fds[iWorker_index], ullWorker_reassigned)
+				&& Recv_vector(viWorker_fds[iWorker_index], vuWorker_counts)
+				&& Recv_vector(viWorker_fds[iWorker_index], vfWorker_sums);
+			uReassigned_ct += (unsigned)ullWorker_reassigned;
+			for (iK_index = 0; iK_index < iK_count; iK_index++) {
+				vuCounts[iK_index] += vuWorker_counts[iK_index];
+				for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++)
+					vdSums[iK_index * iAttribute_ct + iAttribute_index] += vfWorker_sums[iK_index * iAttribute_ct + iAttribute_index];
+			} // for
+		} // for
+		if (!bOk) break;
+
+		// merged in double precision, the workers' sums only hold their shard
+		vfSums.assign(vdSums.begin(), vdSums.end());
+		Finalize_cluster_means(vfSums, vuCounts, false);
+		for (iK_index = 0; iK_index < iK_count; iK_index++)
+			vvfMeans[iK_index].assign(vfSums.begin() + iK_index * iAttribute_ct, vfSums.begin() + (iK_index + 1) * iAttribute_ct);
+
+		bNot_done = Compare_mean_values();
+		iIteration++;
+		if (bNot_done && Budget_exhausted()) bNot_done = false;
+	} // while
+
+	if (!bOk) {
+		if (sError.empty()) sError = "Lost connection to a distributed worker.";
+		cout << "Lost connection to a distributed worker." << endl << endl;
+	}
+	else {
+		// let the workers write their shards
+		vfMeans = Flatten_means(vvfMeans);
+		for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size(); iWorker_index++) {
+			Send_value(viWorker_fds[iWorker_index], (uint32_t)CMD_FINISH);
+			Send_vector(viWorker_fds[iWorker_index], vfMeans);
+		} // for
+
+		// the means and total member counts, in the usual header format
+		strResults_out_stream.open(sOut_file);
+		if (!strResults_out_stream.is_open()) {
+			sError = "Error writing " + sOut_file;
+			cout << sError << endl << endl;
+		} // if
+		for (iK_index = 0; iK_index < iK_count; iK_index++){
+			strResults_out_stream << "Cluster #" << iK_index + 1 << " with mean ";
+			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+				strResults_out_stream << vvfMeans[iK_index][iAttribute_index] << " ";
+			} // for
+			strResults_out_stream << "and member count " << vuCounts[iK_index] << "\n\n";
+		} // for
+		strResults_out_stream.close();
+	} // if
+
+	for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size(); iWorker_index++)
+		close(viWorker_fds[iWorker_index]);
+
+	return;
+} // Cluster_set::Execute_distributed_coordinator
+
+//***********************************************************************
+// Returns true on success
+bool Cluster_set::Distributed_fetch(const vector<int>& viWorker_fds, unsigned long long ullGlobal_index, vector<float>& vfInstance){
+	// Instances are dealt to the workers in turn, so the instance is
+	// ullGlobal_index / workers in the shard of worker ullGlobal_index % workers.
+
+	int iWorker_fd = viWorker_fds[ullGlobal_index % viWorker_fds.size()];
+
+	vfInstance.resize(iAttribute_ct);
+	return Send_value(iWorker_fd, (uint32_t)CMD_FETCH)
+		&& Send_value(iWorker_fd, (uint64_t)(ullGlobal_index / viWorker_fds.size()))
+		&& Recv_vector(iWorker_fd, vfInstance);
+} // Cluster_set::Distributed_fetch
+
+//***********************************************************************
+// Returns true on success
+bool Cluster_set::Distributed_plus_plus(const vector<int>& viWorker_fds){
+	// Initializes using k-means||: a few rounds each sample about
+	// #parallel-oversampling * k candidates across the workers, then
+	// the candidates weighted by their nearest instance counts are
+	// reduced to k means with k-means++.
+
+	// local variables
+	vector<float> vfCandidates, vfNew, vfSampled;
+	vector<double> vdWeights, vdDistance, vdProbability;
+	vector<uint64_t> vullWorker_weights;
+	uint32_t uNew_ct, uSampled_ct;
+	double dCost, dWorker_cost, dTotal, dRandom;
+	size_t szCandidate_ct, szIndex;
+	int iRound, iWorker_index, iSelected, iAttribute_index;
+	float fDifference, fSum_of_squares;
+	bool bOk;
+
+	// start from one instance chosen uniformly
+	bOk = Distributed_fetch(viWorker_fds,
+		uniform_int_distribution<unsigned long long>(0, szInstance_ct - 1)(mtRandom), vfNew);
+
+	for (iRound = 0; bOk; iRound++) {
+		// send the new candidates, get back the cost of all instances
+		uNew_ct = vfNew.size() / iAttribute_ct;
+		for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+			bOk = Send_value(viWorker_fds[iWorker_index], (uint32_t)CMD_COST)
+				&& Send_value(viWorker_fds[iWorker_index], uNew_ct)
+				&& Send_vector(viWorker_fds[iWorker_index], vfNew);
+		} // for
+		dCost = 0;
+		for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+			bOk = Recv_value(viWorker_fds[iWorker_index], dWorker_cost);
+			dCost += dWorker_cost;
+		} // for
+		vfCandidates.insert(vfCandidates.end(), vfNew.begin(), vfNew.end());
+
+		// past the time budget the candidates so far are reduced as they are
+		if (!bOk || iRound == iParallel_rounds || dCost <= 0 || Past_time_budget()) break;
+
+		// each worker samples instances in proportion to their cost
+		for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+			bOk = Send_value(viWorker_fds[iWorker_index], (uint32_t)CMD_SAMPLE)
+				&& Send_value(viWorker_fds[iWorker_index], dCost)
+				&& Send_value(viWorker_fds[iWorker_index], (double)(fParallel_oversampling * iK_count))
+				&& Send_value(viWorker_fds[iWorker_index], (uint32_t)mtRandom());
+		} // for
+		vfNew.clear();
+		for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+			bOk = Recv_value(viWorker_fds[iWorker_index], uSampled_ct);
+			vfSampled.resize((size_t)uSampled_ct * iAttribute_ct);
+			bOk = bOk && Recv_vector(viWorker_fds[iWorker_index], vfSampled);
+			vfNew.insert(vfNew.end(), vfSampled.begin(), vfSampled.end());
+		} // for
+
+		if (vfNew.empty()) break;
+	} // for
+
+	// weight each candidate by the instances nearest to it
+	szCandidate_ct = vfCandidates.size() / iAttribute_ct;
+	vdWeights.assign(szCandidate_ct, 0);
+	vullWorker_weights.resize(szCandidate_ct);
+	for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+		bOk = Send_value(viWorker_fds[iWorker_index], (uint32_t)CMD_WEIGHTS);
+	} // for
+	for (iWorker_index = 0; iWorker_index < (int)viWorker_fds.size() && bOk; iWorker_index++) {
+		bOk = Recv_vector(viWorker_fds[iWorker_index], vullWorker_weights);
+		for (szIndex = 0; szIndex < szCandidate_ct; szIndex++)
+			vdWeights[szIndex] += (double)vullWorker_weights[szIndex];
+	} // for
+	if (!bOk) return false;
+
+	// too few candidates (e.g. many duplicate instances) - add uniform ones
+	while (szCandidate_ct < (size_t)iK_count && bOk) {
+		bOk = Distributed_fetch(viWorker_fds,
+			uniform_int_distribution<unsigned long long>(0, szInstance_ct - 1)(mtRandom), vfNew);
+		vfCandidates.insert(vfCandidates.end(), vfNew.begin(), vfNew.end());
+		vdWeights.push_back(1);
+		szCandidate_ct++;
+	} // while
+	if (!bOk) return false;
+
+	// weighted k-means++ over the candidates
+	vdDistance.assign(szCandidate_ct, DBL_MAX);
+	vdProbability.resize(szCandidate_ct);
+	for (iSelected = 0; iSelected < iK_count; iSelected++) {
+		dTotal = 0;
+		for (szIndex = 0; szIndex < szCandidate_ct; szIndex++) {
+			if (iSelected > 0) {
+				fSum_of_squares = 0;
+				for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++) {
+					fDifference = vfCandidates[szIndex * iAttribute_ct + iAttribute_index] - vvfMeans[iSelected - 1][iAttribute_index];
+					fSum_of_squares += fDifference * fDifference;
+				} // for
+				if (fSum_of_squares < vdDistance[szIndex]) vdDistance[szIndex] = fSum_of_squares;
+				vdProbability[szIndex] = vdWeights[szIndex] * vdDistance[szIndex];
+			}
+			else {
+				vdProbability[szIndex] = vdWeights[szIndex];
+			} // if
+			dTotal += vdProbability[szIndex];
+		} // for
+
+		// every candidate is already a mean - choose uniformly
+		if (dTotal <= 0) {
+			fill(vdProbability.begin(), vdProbability.end(), 1.0);
+			dTotal = (double)szCandidate_ct;
+		} // if
+
+		dRandom = uniform_real_distribution<double>(0, dTotal)(mtRandom);
+		for (szIndex = 0; szIndex < szCandidate_ct - 1; szIndex++) {
+			dRandom -= vdProbability[szIndex];
+			if (dRandom <= 0) break;
+		} // for
+
+		vvfMeans[iSelected].assign(vfCandidates.begin() + szIndex * iAttribute_ct,
+			vfCandidates.begin() + (szIndex + 1) * iAttribute_ct);
+	} // for
+
+	return true;
+} // Cluster_set::Distributed_plus_plus
+
+//***********************************************************************
+void Cluster_set::Execute_distributed_worker(void){
+
+	// local variables
+	int iFd = -1;
+	int iTry;
+	int32_t iShard, iShard_ct, iK;
+	uint32_t uCommand, uNew_ct, uSeed;
+	uint64_t ullIndex;
+	double dCost, dOversampling, dShard_cost;
+	bool bOk, bDone = false;
+	size_t szIndex, szCandidate_ct = 0;
+	int iK_index, iAttribute_index;
+	float fDifference, fSum_of_squares;
+	vector<float> vfNew, vfSampled, vfSums;
+	vector<double> vdDistance;
+	vector<uint32_t> vuNearest, vuCounts;
+	vector<uint64_t> vullWeights;
+	mt19937 mtSample;
+
+	// the coordinator may still be starting up
+	for (iTry = 0; iTry < 100 && iFd < 0; iTry++) {
+		iFd = Socket_open(sDistributed_address, false);
+		if (iFd < 0) this_thread::sleep_for(chrono::milliseconds(100));
+	} // for
+	if (iFd < 0) {
+		sError = "Error connecting to " + sDistributed_address;
+		cout << sError << endl << endl;
+		return;
+	}
+
+	// load this worker's shard of the input
+	bOk = Recv_value(iFd, iShard) && Recv_value(iFd, iShard_ct) && Recv_value(iFd, iK);
+	if (bOk) {
+		iShard_index = iShard;
+		iShard_count = iShard_ct;
+		iK_count = iK;
+		sOut_file += "." + to_string(iShard_index); // workers may share a control file
+		bOk = Read_input_data();
+	} // if
+	if (bOk) {
+		Place_input_data_numa();
+		bOk = Send_value(iFd, (uint64_t)vclInput_data.size()) && Send_value(iFd, (int32_t)iAttribute_ct);
+	} // if
+
+	vdDistance.assign(vclInput_data.size(), DBL_MAX);
+	vuNearest.assign(vclInput_data.size(), 0);
+	vfSums.resize(iK_count * iAttribute_ct);
+	vuCounts.resize(iK_count);
+
+	while (bOk && !bDone && Recv_value(iFd, uCommand)) {
+		switch (uCommand) {
+		case CMD_COST:
+			// distance from each instance to its nearest candidate so far
+			bOk = Recv_value(iFd, uNew_ct);
+			vfNew.resize((size_t)uNew_ct * iAttribute_ct);
+			bOk = bOk && Recv_vector(iFd, vfNew);
+			dShard_cost = 0;
+			for (szIndex = 0; szIndex < vclInput_data.size(); szIndex++) {
+				for (iK_index = 0; iK_index < (int)uNew_ct; iK_index++) {
+					fSum_of_squares = 0;
+					for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++) {
+						fDifference = vclInput_data[szIndex].vfAttribute[iAttribute_index] - vfNew[iK_index * iAttribute_ct + iAttribute_index];
+						fSum_of_squares += fDifference * fDifference;
+					} // for
+					if (fSum_of_squares < vdDistance[szIndex]) {
+						vdDistance[szIndex] = fSum_of_squares;
+						vuNearest[szIndex] = szCandidate_ct + iK_index;
+					} // if
+				} // for
+				dShard_cost += vdDistance[szIndex];
+			} // for
+			szCandidate_ct += uNew_ct;
+			bOk = bOk && Send_value(iFd, dShard_cost);
+			break;
+
+		case CMD_SAMPLE:
+			// keep each instance with probability oversampling * cost / total cost
+			bOk = Recv_value(iFd, dCost) && Recv_value(iFd, dOversampling) && Recv_value(iFd, uSeed);
+			mtSample.seed(uSeed);
+			vfSampled.clear();
+			for (szIndex = 0; szIndex < vclInput_data.size(); szIndex++) {
+				if (uniform_real_distribution<double>(0, 1)(mtSample) < dOversampling * vdDistance[szIndex] / dCost) {
+					vfSampled.insert(vfSampled.end(), vclInput_data[szIndex].vfAttribute.begin(), vclInput_data[szIndex].vfAttribute.end());
+				} // if
+			} // for
+			bOk = bOk && Send_value(iFd, (uint32_t)(vfSampled.size() / iAttribute_ct)) && Send_vector(iFd, vfSampled);
+			break;
+
+		case CMD_WEIGHTS:
+			vullWeights.assign(szCandidate_ct, 0);
+			for (szIndex = 0; szIndex < vclInput_data.size(); szIndex++) vullWeights[vuNearest[szIndex]]++;
+			bOk = Send_vector(iFd, vullWeights);
+			break;
+
+		case CMD_FETCH:
+			bOk = Recv_value(iFd, ullIndex) && ullIndex < vclInput_data.size()
+				&& Send_vector(iFd, vclInput_data[ullIndex].vfAttribute);
+			break;
+
+		case CMD_ASSIGN:
+			// the same assignment pass as a single process. comparing the
+			// means records their drift for #drift-skip
+			vvfOld_means = vvfMeans;
+			vfNew.resize(iK_count * iAttribute_ct);
+			bOk = Recv_vector(iFd, vfNew);
+			for (iK_index = 0; iK_index < iK_count; iK_index++)
+				vvfMeans[iK_index].assign(vfNew.begin() + iK_index * iAttribute_ct, vfNew.begin() + (iK_index + 1) * iAttribute_ct);
+			Compare_mean_values();
+			Cluster_data();
+
+			// partial sums for the coordinator
+			fill(vfSums.begin(), vfSums.end(), 0.0f);
+			fill(vuCounts.begin(), vuCounts.end(), 0);
+			Calculate_cluster_means_process(0, vclInput_data.size(), vfSums, vuCounts);
+			bOk = bOk && Send_value(iFd, (uint64_t)uReassigned_ct) && Send_vector(iFd, vuCounts) && Send_vector(iFd, vfSums);
+			iIteration++;
+			break;
+
+		case CMD_FINISH:
+			// the means of the last assignment, written with this shard's members
+			vfNew.resize(iK_count * iAttribute_ct);
+			bOk = Recv_vector(iFd, vfNew);
+			for (iK_index = 0; iK_index < iK_count && bOk; iK_index++)
+				vvfMeans[iK_index].assign(vfNew.begin() + iK_index * iAttribute_ct, vfNew.begin() + (iK_index + 1) * iAttribute_ct);
+			if (bOk) Write_output_data();
+			bDone = true;
+			break;
+
+		default:
+			bOk = false;
+		} // switch
+	} // while
+
+	if (!bDone) {
+		if (sError.empty()) sError = "Lost connection to the distributed coordinator.";
+		cout << "Lost connection to the distributed coordinator." << endl << endl;
+	} // if
+
+	close(iFd);
+
+	return;
+} // Cluster_set::Execute_distributed_worker
+
+//***********************************************************************
@@ -0,0 +1,337 @@
+//***********************************************************************
+// k-means-hierarchical.cpp
+//
+//   this is the two level mode of the K-means classification algorithm,
+//   for very large K (e.g. vector quantization codebooks). the input data is
+//   first clustered into about sqrt(K) coarse clusters, then the instances of
+//   each coarse cluster are clustered independently, in parallel, into that
+//   cluster's share of the K fine clusters. an optional refinement then lets
+//   instances move to the fine clusters of neighbouring coarse clusters
+//
+// INVOKE APPLICATION USING: k-means++ <control file name>
+//   with #hierarchical 1 in the control file
+//
+// OUTPUTS: (to disk file)
+//        <output_filename> - the usual results for the K fine clusters,
+//             followed by each coarse cluster's mean and fine clusters
+//
+//***********************************************************************
+// Copyright 2014 Isaac Brodsky
+//
+//***********************************************************************
+
+#include "k-means-multi.h"
+#include <thread>
+#include <atomic>
+#include <future>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+//***********************************************************************
+// class Cluster_set hierarchical method declarations
+//***********************************************************************
+void Cluster_set::Execute_hierarchical_clustering(void){
+
+	// local variables
+	int iFine_k = iK_count;
+	int iCoarse_k, iCell, iK_index, iAttribute_index, iBest_cell, iStep;
+	unsigned uReassigned;
+	size_t szData, szIndex;
+	float fDifference, fSum_of_squares;
+	double dBest_gap, dGap;
+	vector<Cluster_instance> vclAll;
+	vector< vector<unsigned> > vvuCell_members;
+	vector<double> vdCell_exact;
+	vector<int> viCell_share, viCell_offset;
+	vector<int> viInstance_coarse;
+	vector<unsigned> vuCell_seeds;
+	vector< vector<int> > vviCoarse_candidates;
+	vector< pair<float, int> > vpfiCell_distance;
+	vector<float> vfSums;
+	vector<unsigned> vuCounts;
+	vector<thread> vtThreads;
+	atomic<int> aiNext_cell(0);
+	int iTotal_share;
+
+	// read the input data
+	if (!Read_input_data()) return;
+
+	szData = vclInput_data.size();
+	if (szData < (size_t)iFine_k) {
+		sError = "Fewer instances than clusters.";
+		cout << sError << endl << endl;
+		return;
+	} // if
+
+	// the time budget starts once the data is loaded, the cells share it
+	tpClustering_start = chrono::steady_clock::now();
+
+	iCoarse_k = iCoarse_k_count > 0 ? iCoarse_k_count : (int)lround(sqrt((double)iFine_k));
+	iCoarse_k = max(1, min(iCoarse_k, iFine_k));
+
+	// the coarse pass is the usual clustering, with this set's configuration
+	vclAll.swap(vclInput_data);
+	{
+		Cluster_set clCoarse(*this);
+		clCoarse.bHierarchical = false;
+		clCoarse.iK_count = iCoarse_k;
+		clCoarse.vclInput_data.swap(vclAll);
+		clCoarse.szInstance_ct = szData;
+		clCoarse.Allocate_means();
+		clCoarse.Place_input_data_numa();
+		clCoarse.Run_clustering();
+
+		vclAll.swap(clCoarse.vclInput_data);
+		vvfCoarse_means = clCoarse.vvfMeans;
+		dSeeding_ms = clCoarse.dSeeding_ms;
+		mtRandom = clCoarse.mtRandom; // carry on the random sequence
+	}
+
+	// partition the instances by coarse cluster
+	vvuCell_members.resize(iCoarse_k);
+	viInstance_coarse.resize(szData);
+	for (szIndex = 0; szIndex < szData; szIndex++) {
+		viInstance_coarse[szIndex] = vclAll[szIndex].iCluster;
+		vvuCell_members[vclAll[szIndex].iCluster].push_back(szIndex);
+	} // for
+
+	// share the fine clusters in proportion to the cell sizes, at least
+	// one for each non-empty cell and at most one per instance
+	vdCell_exact.resize(iCoarse_k);
+	viCell_share.resize(iCoarse_k);
+	iTotal_share = 0;
+	for (iCell = 0; iCell < iCoarse_k; iCell++) {
+		vdCell_exact[iCell] = (double)iFine_k * vvuCell_members[iCell].size() / (double)szData;
+		viCell_share[iCell] = vvuCell_members[iCell].empty() ? 0
+			: max(1, min((int)vvuCell_members[iCell].size(), (int)vdCell_exact[iCell]));
+		iTotal_share += viCell_share[iCell];
+	} // for
+	while (iTotal_share != iFine_k) {
+		// give to the most under-served cell with room, or take from the most over-served
+		iBest_cell = -1;
+		dBest_gap = -DBL_MAX;
+		for (iCell = 0; iCell < iCoarse_k; iCell++) {
+			dGap = vdCell_exact[iCell] - viCell_share[iCell];
+			if (iTotal_share > iFine_k) dGap = -dGap;
+			if ((iTotal_share < iFine_k ? viCell_share[iCell] < (int)vvuCell_members[iCell].size() : viCell_share[iCell] > 1)
+				&& dGap > dBest_gap) {
+				dBest_gap = dGap;
+				iBest_cell = iCell;
+			} // if
+		} // for
+		viCell_share[iBest_cell] += iTotal_share < iFine_k ? 1 : -1;
+		iTotal_share += iTotal_share < iFine_k ? 1 : -1;
+	} // while
+
+	// fine clusters of each cell are numbered consecutively
+	viCell_offset.resize(iCoarse_k);
+	viFine_coarse.resize(iFine_k);
+	for (iCell = 0; iCell < iCoarse_k; iCell++) {
+		viCell_offset[iCell] = iCell > 0 ? viCell_offset[iCell - 1] + viCell_share[iCell - 1] : 0;
+		for (iK_index = 0; iK_index < viCell_share[iCell]; iK_index++) viFine_coarse[viCell_offset[iCell] + iK_index] = iCell;
+		vuCell_seeds.push_back(mtRandom());
+	} // for
+
+	// the configuration for each cell, copied before the threads start
+	Cluster_set clTemplate(*this);
+	clTemplate.bHierarchical = false;
+	clTemplate.bQuiet = true;
+	clTemplate.iNumThreads = 1; // the cells run in parallel instead
+	clTemplate.iNumPlusPlusThreads = 1;
+	clTemplate.bUseNuma = false;
+	clTemplate.vvfMeans.clear();
+	clTemplate.vvfOld_means.clear();
+	clTemplate.vsLabels.clear(); // only the top level writes the labels
+	clTemplate.umLabel_ids.clear();
+	clTemplate.vvfCoarse_means.clear();
+	clTemplate.viFine_coarse.clear();
+
+	// cluster each cell into its share of the fine clusters
+	for (iStep = 0; iStep < max(iNumThreads, 1); iStep++) {
+		vtThreads.push_back(thread([&]() {
+			int iThread_cell;
+			size_t szMember;
+			while ((iThread_cell = aiNext_cell++) < iCoarse_k) {
+				if (viCell_share[iThread_cell] == 0) continue;
+
+				Cluster_set clCell(clTemplate);
+				clCell.iK_count = viCell_share[iThread_cell];
+				clCell.mtRandom.seed(vuCell_seeds[iThread_cell]);
+				for (szMember = 0; szMember < vvuCell_members[iThread_cell].size(); szMember++) {
+					clCell.vclInput_data.push_back(move(vclAll[vvuCell_members[iThread_cell][szMember]]));
+					clCell.vclInput_data.back().iCluster = -1;
+				} // for
+				clCell.szInstance_ct = clCell.vclInput_data.size();
+				clCell.Allocate_means();
+				clCell.Run_clustering();
+
+				// move the instances and means back, numbered globally
+				for (szMember = 0; szMember < vvuCell_members[iThread_cell].size(); szMember++) {
+					clCell.vclInput_data[szMember].iCluster += viCell_offset[iThread_cell];
+					vclAll[vvuCell_members[iThread_cell][szMember]] = move(clCell.vclInput_data[szMember]);
+				} // for
+				for (int iCell_k = 0; iCell_k < clCell.iK_count; iCell_k++)
+					vvfMeans[viCell_offset[iThread_cell] + iCell_k] = clCell.vvfMeans[iCell_k];
+			} // while
+		}));
+	} // Launch all threads
+	for (iStep = 0; iStep < (int)vtThreads.size(); iStep++) vtThreads[iStep].join();
+
+	vclInput_data.swap(vclAll);
+
+	// refine over the fine clusters of each cell's nearest coarse cells
+	if (iHierarchical_refine > 0) {
+		vviCoarse_candidates.resize(iCoarse_k);
+		for (iCell = 0; iCell < iCoarse_k; iCell++) {
+			vpfiCell_distance.clear();
+			for (iBest_cell = 0; iBest_cell < iCoarse_k; iBest_cell++) {
+				fSum_of_squares = 0;
+				for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++) {
+					fDifference = vvfCoarse_means[iCell][iAttribute_index] - vvfCoarse_means[iBest_cell][iAttribute_index];
+					fSum_of_squares += fDifference * fDifference;
+				} // for
+				vpfiCell_distance.push_back(make_pair(fSum_of_squares, iBest_cell));
+			} // for
+			sort(vpfiCell_distance.begin(), vpfiCell_distance.end());
+			for (iStep = 0; iStep < min(max(iHierarchical_neighbours, 1), iCoarse_k); iStep++) {
+				iBest_cell = vpfiCell_distance[iStep].second;
+				for (iK_index = 0; iK_index < viCell_share[iBest_cell]; iK_index++)
+					vviCoarse_candidates[iCell].push_back(viCell_offset[iBest_cell] + iK_index);
+			} // for
+		} // for
+
+		vfSums.resize(iFine_k * iAttribute_ct);
+		vuCounts.resize(iFine_k);
+		for (iStep = 0; iStep < iHierarchical_refine; iStep++) {
+			if (Past_time_budget()) {
+				if (!bQuiet) cout << "Stopped the refinement at the time budget after " << iStep << " iterations." << endl;
+				break;
+			} // if
+
+			if (iNumThreads == 1)
+			{
+				//Don't bother creating more threads.
+				uReassigned = Hierarchical_refine_process(0, szData, viInstance_coarse, vviCoarse_candidates);
+			}
+			else
+			{
+				// local variables
+				unsigned uPerThread;
+				unsigned uDataStart;
+				int iThread_index;
+				vector<future<unsigned>> vtRefine_threads;
+
+				uDataStart = 0;
+				uPerThread = szData / iNumThreads;
+
+				//Split the dataset into parts and launch as individual
+				//threads.
+				for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+				{
+					//Force the last thread to take remaining data
+					if (iThread_index == iNumThreads - 1)
+					{
+						uPerThread = szData - uDataStart;
+					}
+
+					vtRefine_threads.push_back(async(launch::async, [=, &viInstance_coarse, &vviCoarse_candidates](unsigned uStart, unsigned uLength) {
+						return Hierarchical_refine_process(uStart, uLength, viInstance_coarse, vviCoarse_candidates); }, uDataStart, uPerThread));
+
+					uDataStart += uPerThread;
+				} // Launch all threads
+
+				//Wait for all threads to complete.
+				uReassigned = 0;
+				for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+				{
+					uReassigned += vtRefine_threads[iThread_index].get();
+				} // Wait for all threads
+			}
+
+			// new means; a fine cluster left empty keeps its mean
+			fill(vfSums.begin(), vfSums.end(), 0.0f);
+			fill(vuCounts.begin(), vuCounts.end(), 0);
+			Calculate_cluster_means_process(0, szData, vfSums, vuCounts);
+			Finalize_cluster_means(vfSums, vuCounts, false);
+			for (iK_index = 0; iK_index < iFine_k; iK_index++) {
+				if (vuCounts[iK_index] == 0) continue;
+				vvfMeans[iK_index].assign(vfSums.begin() + iK_index * iAttribute_ct, vfSums.begin() + (iK_index + 1) * iAttribute_ct);
+			} // for
+
+			if (uReassigned == 0) break;
+		} // for
+	} // if
+
+	if (bReport_stats) {
+		cout << "Coarse seeding took " << dSeeding_ms << " ms, final inertia " << Calculate_inertia() << endl;
+	} // if
+
+	// write the output data
+	Write_output_data();
+
+	return;
+} // Cluster_set::Execute_hierarchical_clustering
+
+//***********************************************************************
+// Returns the number of instances that changed cluster
+unsigned Cluster_set::Hierarchical_refine_process(unsigned uIndex, unsigned uLength, const vector<int>& viInstance_coarse, const vector< vector<int> >& vviCoarse_candidates){
+	// Reassigns each instance to the nearest fine cluster of the coarse
+	// cells next to its own.
+
+	// local variables
+	unsigned uReassigned = 0;
+	unsigned uLast = uIndex + uLength;
+	float fDifference, fSum_of_squares, fBest_squared_difference;
+	int iBest_index, iAttribute_index;
+	size_t szCandidate;
+
+	for (; uIndex < uLast; uIndex++) {
+		Cluster_instance& clData_instance = vclInput_data[uIndex];
+		const vector<int>& viCandidates = vviCoarse_candidates[viInstance_coarse[uIndex]];
+
+		fBest_squared_difference = FLT_MAX;
+		iBest_index = clData_instance.iCluster;
+		for (szCandidate = 0; szCandidate < viCandidates.size(); szCandidate++) {
+			fSum_of_squares = 0;
+			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++) {
+				fDifference = clData_instance.vfAttribute[iAttribute_index] - vvfMeans[viCandidates[szCandidate]][iAttribute_index];
+				fSum_of_squares += fDifference * fDifference;
+			} // for
+			if (fSum_of_squares < fBest_squared_difference) {
+				fBest_squared_difference = fSum_of_squares;
+				iBest_index = viCandidates[szCandidate];
+			} // if
+		} // for
+
+		if (clData_instance.iCluster != iBest_index) uReassigned++;
+		clData_instance.iCluster = iBest_index;
+	} // for
+
+	return uReassigned;
+} // Cluster_set::Hierarchical_refine_process
+
+//***********************************************************************
+void Cluster_set::Write_coarse_mapping(ostream& strResults_out_stream){
+
+	// local variables
+	int iCell, iK_index, iAttribute_index;
+
+	// same header format as the fine clusters
+	for (iCell = 0; iCell < (int)vvfCoarse_means.size(); iCell++) {
+		strResults_out_stream << "Coarse cluster #" << iCell + 1 << " with mean ";
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+			strResults_out_stream << vvfCoarse_means[iCell][iAttribute_index] << " ";
+		} // for
+		strResults_out_stream << "and fine clusters";
+		for (iK_index = 0; iK_index < (int)viFine_coarse.size(); iK_index++) {
+			if (viFine_coarse[iK_index] == iCell) strResults_out_stream << " " << iK_index + 1;
+		} // for
+		strResults_out_stream << "\n";
+	} // for
+	strResults_out_stream << "\n";
+
+	return;
+} // Cluster_set::Write_coarse_mapping
+
+//***********************************************************************
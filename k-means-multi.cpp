@@ -15,13 +15,50 @@
 //
 //			   control labels: #k-count, #input-filename, #output-filename, #use-labels,
 //				 #tolerance, #plus-plus, #plus-plus-threads, #plus-plus-random-seed,
-//				 #num-threads, #EOF
+//				 #num-threads, #online, #online-learning-rate, #online-snapshot-interval,
+//				 #online-reservoir-size, #online-dead-after, #online-warmup, #label-report,
+//				 #reassign-tolerance, #max-iterations, #time-budget-ms, #drift-skip,
+//				 #numa, #distributed-role, #distributed-address, #distributed-workers,
+//				 #parallel-rounds, #parallel-oversampling, #afk-mc2, #afk-mc2-chain-length,
+//				 #report-stats, #hierarchical, #coarse-k-count, #hierarchical-refine,
+//				 #hierarchical-neighbours, #sparse-input, #server, #server-address,
+//				 #server-watch-directory, #server-threads, #server-cache-mb,
+//				 #server-poll-ms, #EOF
 //
 //             values: k value = integer, input datafile name = string,
 //				 output datafile name = string, use data labels = boolean (1, 0),
 //				 stopping tolerance value = float, use k-means++ = boolean (1, 0),
 //				 number of k-means++ threads = integer, random seed for k-means++ = integer,
-//				 number of threads = integer, eof = no value
+//				 number of threads = integer, use online mode = boolean (1, 0),
+//				 online learning rate = float (0 for count based),
+//				 points between snapshots = integer, reservoir sample size = integer,
+//				 points before an idle cluster is respawned = integer,
+//				 points the means are seeded from = integer (0 for 10 times k),
+//				 write a label histogram and purity report = boolean (1, 0),
+//				 stopping fraction of reassigned instances = float (negative to disable),
+//				 maximum iterations = integer (0 for no limit),
+//				 time budget in milliseconds = integer (0 for no limit),
+//				 skip stable instances using mean drift bounds = boolean (1, 0),
+//				 place data and threads by NUMA node = boolean (1, 0),
+//				 distributed role = string (coordinator, worker),
+//				 distributed address = string (host:port or unix:path),
+//				 number of distributed workers = integer,
+//				 k-means|| seeding rounds = integer,
+//				 k-means|| candidates per round as a multiple of k = float,
+//				 use AFK-MC2 approximate k-means++ seeding = boolean (1, 0),
+//				 AFK-MC2 markov chain length = integer,
+//				 print seeding time and final inertia = boolean (1, 0),
+//				 use two level k-means = boolean (1, 0),
+//				 number of coarse clusters = integer (0 for the square root of k),
+//				 global refinement iterations = integer,
+//				 coarse cells searched by the refinement = integer,
+//				 read index:value sparse input = boolean (1, 0),
+//				 run as a job server = boolean (1, 0),
+//				 server address = string (host:port or unix:path),
+//				 directory watched for control files = string,
+//				 threads shared by the server's jobs = integer (0 for one per cpu),
+//				 dataset cache size in megabytes = integer (0 to disable),
+//				 milliseconds between directory scans = integer, eof = no value
 //
 //        <datafile.dat> - classification set - filename specified in the control file
 //             attribute count - don't include the classification in
@@ -55,6 +92,9 @@
 #include <thread>
 #include <cfloat>
 #include <future>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
 
 //***********************************************************************
 // class Cluster_instance method declarations
@@ -65,6 +105,11 @@ Cluster_instance::Cluster_instance(void){
 	// make room for the attributes
 	//vvfAttributes.resize(iAttribute_ct);
 
+	// not yet assigned to a cluster
+	iCluster = -1;
+	fUpper = 0;
+	fLower = 0;
+
 	return;
 } //Cluster_instance::Cluster_instance
 
@@ -90,6 +135,50 @@ Cluster_set::Cluster_set(void){
 	mtRandom = mt19937(rd());
 	iNumThreads = 1;
 	iNumPlusPlusThreads = 1;
+	// Batch clustering by default.
+	bUseOnline = false;
+	fOnline_learning_rate = 0;
+	iOnline_snapshot_interval = 100000;
+	iOnline_reservoir_size = 1000;
+	iOnline_dead_after = 100000;
+	iOnline_warmup = 0;
+	bLabel_report = false;
+	// No reassignment, iteration or time limits by default.
+	fReassign_tolerance = -1;
+	uReassigned_ct = 0;
+	iMax_iterations = 0;
+	iTime_budget_ms = 0;
+	bDrift_skip = false;
+	fMax_drift = 0;
+	// Place data by NUMA node when there is more than one.
+	bUseNuma = true;
+	iNuma_node_ct = 1;
+	szInstance_ct = 0;
+	// Not distributed by default.
+	sDistributed_address = "127.0.0.1:7070";
+	iDistributed_workers = 1;
+	iShard_index = 0;
+	iShard_count = 1;
+	iParallel_rounds = 5;
+	fParallel_oversampling = 2;
+	// Exact k-means++ seeding by default.
+	bUse_afk_mc2 = false;
+	iAfk_mc2_chain_length = 200;
+	bReport_stats = false;
+	dSeeding_ms = 0;
+	// Flat clustering by default.
+	bHierarchical = false;
+	iCoarse_k_count = 0;
+	iHierarchical_refine = 0;
+	iHierarchical_neighbours = 3;
+	bQuiet = false;
+	bSparse_input = false;
+	// Run a single job by default.
+	bServer = false;
+	iServer_threads = 0;
+	iServer_cache_mb = 1024;
+	iServer_poll_ms = 500;
+	pclDataset_cache = NULL;
 
 	return;
 } //Cluster_set::Cluster_set
@@ -148,13 +237,107 @@ void Cluster_set::Read_control_data(string sControlFilename) {
 			else if (sTitle == "#num-threads"){ // Number of parallel threads
 				strInput_stream >> iNumThreads;
 			} // if
+			else if (sTitle == "#online"){ // Use the online (streaming) mode
+				strInput_stream >> bUseOnline;
+			} // if
+			else if (sTitle == "#online-learning-rate"){ // Online learning rate, 0 for count based
+				strInput_stream >> fOnline_learning_rate;
+			} // if
+			else if (sTitle == "#online-snapshot-interval"){ // Points between centroid snapshots
+				strInput_stream >> iOnline_snapshot_interval;
+			} // if
+			else if (sTitle == "#online-reservoir-size"){ // Size of the respawn reservoir sample
+				strInput_stream >> iOnline_reservoir_size;
+			} // if
+			else if (sTitle == "#online-dead-after"){ // Idle points before a cluster is respawned
+				strInput_stream >> iOnline_dead_after;
+			} // if
+			else if (sTitle == "#online-warmup"){ // Instances the means are seeded from, 0 for 10 times k
+				strInput_stream >> iOnline_warmup;
+			} // if
+			else if (sTitle == "#label-report"){ // Write per-cluster label histograms
+				strInput_stream >> bLabel_report;
+			} // if
+			else if (sTitle == "#reassign-tolerance"){ // Stopping fraction of reassigned instances
+				strInput_stream >> fReassign_tolerance;
+			} // if
+			else if (sTitle == "#max-iterations"){ // Iteration cap, 0 for no limit
+				strInput_stream >> iMax_iterations;
+			} // if
+			else if (sTitle == "#time-budget-ms"){ // Time budget in milliseconds, 0 for no limit
+				strInput_stream >> iTime_budget_ms;
+			} // if
+			else if (sTitle == "#drift-skip"){ // Skip stable instances using mean drift bounds
+				strInput_stream >> bDrift_skip;
+			} // if
+			else if (sTitle == "#numa"){ // Place data and threads by NUMA node
+				strInput_stream >> bUseNuma;
+			} // if
+			else if (sTitle == "#distributed-role"){ // coordinator or worker
+				strInput_stream >> sDistributed_role;
+			} // if
+			else if (sTitle == "#distributed-address"){ // host:port or unix:path
+				strInput_stream >> sDistributed_address;
+			} // if
+			else if (sTitle == "#distributed-workers"){ // Workers the coordinator waits for
+				strInput_stream >> iDistributed_workers;
+			} // if
+			else if (sTitle == "#parallel-rounds"){ // Rounds of k-means|| seeding
+				strInput_stream >> iParallel_rounds;
+			} // if
+			else if (sTitle == "#parallel-oversampling"){ // k-means|| candidates per round, times k
+				strInput_stream >> fParallel_oversampling;
+			} // if
+			else if (sTitle == "#afk-mc2"){ // Approximate k-means++ seeding with AFK-MC2
+				strInput_stream >> bUse_afk_mc2;
+			} // if
+			else if (sTitle == "#afk-mc2-chain-length"){ // Markov chain steps per AFK-MC2 center
+				strInput_stream >> iAfk_mc2_chain_length;
+			} // if
+			else if (sTitle == "#report-stats"){ // Print seeding time and final inertia
+				strInput_stream >> bReport_stats;
+			} // if
+			else if (sTitle == "#hierarchical"){ // Two level k-means for very large k
+				strInput_stream >> bHierarchical;
+			} // if
+			else if (sTitle == "#coarse-k-count"){ // Coarse clusters, 0 for the square root of k
+				strInput_stream >> iCoarse_k_count;
+			} // if
+			else if (sTitle == "#hierarchical-refine"){ // Global refinement iterations
+				strInput_stream >> iHierarchical_refine;
+			} // if
+			else if (sTitle == "#hierarchical-neighbours"){ // Coarse cells searched when refining
+				strInput_stream >> iHierarchical_neighbours;
+			} // if
+			else if (sTitle == "#sparse-input"){ // Input is index:value pairs
+				strInput_stream >> bSparse_input;
+			} // if
+			else if (sTitle == "#server"){ // Run control files sent to this process as jobs
+				strInput_stream >> bServer;
+			} // if
+			else if (sTitle == "#server-address"){ // host:port or unix:path to accept jobs on
+				strInput_stream >> sServer_address;
+			} // if
+			else if (sTitle == "#server-watch-directory"){ // Directory to take control files from
+				strInput_stream >> sServer_watch_directory;
+			} // if
+			else if (sTitle == "#server-threads"){ // Threads shared by all jobs, 0 for one per cpu
+				strInput_stream >> iServer_threads;
+			} // if
+			else if (sTitle == "#server-cache-mb"){ // Memory cap of the dataset cache, 0 to disable
+				strInput_stream >> iServer_cache_mb;
+			} // if
+			else if (sTitle == "#server-poll-ms"){ // Milliseconds between scans of the directory
+				strInput_stream >> iServer_poll_ms;
+			} // if
 			else{
 				cout << "Unrecognized directive in control file." << endl;
 			}
 		} // while read control file
 	} // if control file open
 	else { // print error message
-		cout << "Error reading the file " << sControlFilename << endl << endl;
+		sError = "Error reading the file " + sControlFilename;
+		cout << sError << endl << endl;
 	}
 
 	strInput_stream.close();  // close filestream
@@ -165,33 +348,54 @@ void Cluster_set::Read_control_data(string sControlFilename) {
 //***********************************************************************
 void Cluster_set::Execute_clustering(void){
 
-	// local variables
-	bool bNot_done = true;
+	// the server runs other control files until it is stopped
+	if (bServer) {
+		Execute_server();
+		return;
+	} // if
 
-	// read the input data
-	if (Read_input_data()) {
+	// the online mode consumes the input as a stream instead
+	if (bUseOnline) {
+		Execute_online_clustering();
+		return;
+	} // if
 
-		// loop until we are done clustering - the mean values don't change
-		while (bNot_done){
+	// distributed modes split the input between worker processes
+	if (sDistributed_role == "coordinator") {
+		Execute_distributed_coordinator();
+		return;
+	}
+	else if (sDistributed_role == "worker") {
+		Execute_distributed_worker();
+		return;
+	} // if
 
-			// identify the k means values
-			Identify_mean_values();
+	// sparse input keeps its own compressed storage
+	if (bSparse_input) {
+		Execute_sparse_clustering();
+		return;
+	} // if
 
-			// cluster the input data using the k means values
-			Cluster_data();
+	// very large k clusters coarse cells first, then each cell
+	if (bHierarchical) {
+		Execute_hierarchical_clustering();
+		return;
+	} // if
 
-			// calculate the means of the clusters
-			Calculate_cluster_means();
+	// read the input data
+	if (Read_input_data()) {
 
-			// compare the old mean values to the new mean values
-			// if the difference is less than the tolerance value then stop clustering
-			bNot_done = Compare_mean_values();
+		// spread the data over the NUMA nodes for the worker threads
+		Place_input_data_numa();
 
-			// increment the iteration
-			iIteration++;
+		// cluster until the means settle, the time budget starts now
+		tpClustering_start = chrono::steady_clock::now();
+		Run_clustering();
 
-			// end the main loop
-		} // while
+		if (bReport_stats) {
+			cout << "Seeding took " << dSeeding_ms << " ms, clustering took " << iIteration
+				<< " iterations, final inertia " << Calculate_inertia() << endl;
+		} // if
 
 		// write the output data
 		Write_output_data();
@@ -200,6 +404,96 @@ void Cluster_set::Execute_clustering(void){
 	return;
 } // Cluster_set::Execute_clustering
 
+//***********************************************************************
+void Cluster_set::Run_clustering(void){
+
+	// local variables
+	bool bNot_done = true;
+
+	// loop until we are done clustering - the mean values don't change
+	while (bNot_done){
+
+		// identify the k means values
+		Identify_mean_values();
+
+		// cluster the input data using the k means values
+		Cluster_data();
+
+		// calculate the means of the clusters
+		Calculate_cluster_means();
+
+		// compare the old mean values to the new mean values
+		// if the difference is less than the tolerance value then stop clustering
+		bNot_done = Compare_mean_values();
+
+		// increment the iteration
+		iIteration++;
+
+		// stop at the iteration and time budgets, keeping the latest
+		// (lowest cost) means and assignments
+		if (bNot_done && Budget_exhausted()) bNot_done = false;
+
+		// end the main loop
+	} // while
+
+	return;
+} // Cluster_set::Run_clustering
+
+//***********************************************************************
+// Returns true if the iteration or time budget has been used up
+bool Cluster_set::Budget_exhausted(void){
+
+	if (iMax_iterations > 0 && iIteration >= iMax_iterations) {
+		if (!bQuiet) cout << "Stopped at the iteration limit after " << iIteration << " iterations." << endl;
+		return true;
+	} // if
+
+	if (Past_time_budget()) {
+		if (!bQuiet) cout << "Stopped at the time budget after " << iIteration << " iterations." << endl;
+		return true;
+	} // if
+
+	return false;
+} // Cluster_set::Budget_exhausted
+
+//***********************************************************************
+// Returns true once #time-budget-ms has passed since the clustering started
+bool Cluster_set::Past_time_budget(void){
+
+	// local variables
+	chrono::milliseconds msElapsed;
+
+	if (iTime_budget_ms <= 0) return false;
+
+	msElapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - tpClustering_start);
+	return msElapsed.count() >= iTime_budget_ms;
+} // Cluster_set::Past_time_budget
+
+//***********************************************************************
+// Called before each new seed is chosen. Past the time budget the means
+// not seeded yet are set to the first instances, as without k-means++.
+bool Cluster_set::Seeding_out_of_time(int iSelected_points){
+
+	// local variables
+	size_t szNonzero;
+
+	if (iSelected_points < 1 || !Past_time_budget()) return false;
+
+	if (!bQuiet) cout << "Stopped seeding at the time budget after " << iSelected_points << " of " << iK_count << " means." << endl;
+	for (; iSelected_points < iK_count; iSelected_points++) {
+		if (bSparse_input) {
+			fill(vvfMeans[iSelected_points].begin(), vvfMeans[iSelected_points].end(), 0.0f);
+			for (szNonzero = vszRow_start[iSelected_points]; szNonzero < vszRow_start[iSelected_points + 1]; szNonzero++)
+				vvfMeans[iSelected_points][vuColumn[szNonzero]] = vfValue[szNonzero];
+		}
+		else {
+			vvfMeans[iSelected_points] = vclInput_data[iSelected_points].vfAttribute;
+		} // if
+	} // for
+
+	return true;
+} // Cluster_set::Seeding_out_of_time
+
 //***********************************************************************
 // class Cluster_set private method declarations
 //***********************************************************************
@@ -209,9 +503,15 @@ void Cluster_set::Execute_clustering(void){
 bool Cluster_set::Read_input_data(void){
 
 	// local variables
-	int iAttribute_index, iCluster_index;
+	int iAttribute_index;
 	float fInput_attribute;
 	bool bResult;
+	string sLabel;
+	uint32_t uBlank_label;
+	unsigned long long ullRead_ct = 0;
+
+	// jobs of the server mode share parsed data sets
+	if (pclDataset_cache != NULL && iShard_count == 1) return Read_cached_input_data();
 
 	// declare an input stream to read the key
 	ifstream strInput_stream;
@@ -228,6 +528,7 @@ bool Cluster_set::Read_input_data(void){
 		strInput_stream >> iAttribute_ct;
 
 		clInput_instance.vfAttribute.resize(iAttribute_ct);
+		uBlank_label = Intern_label("BLANK");
 
 		while (!strInput_stream.eof()){
 
@@ -239,10 +540,11 @@ bool Cluster_set::Read_input_data(void){
 
 			if (bUseLabels) {
 				// read the classification name
-				strInput_stream >> clInput_instance.sClassification;
+				strInput_stream >> sLabel;
+				clInput_instance.uLabel = Intern_label(sLabel);
 			}
 			else {
-				clInput_instance.sClassification = "BLANK";
+				clInput_instance.uLabel = uBlank_label;
 			} // if
 			
 			if (strInput_stream.fail()) {
@@ -251,25 +553,21 @@ bool Cluster_set::Read_input_data(void){
 				break;
 			}
 
-			// save the data in the vector set
-			vclInput_data.push_back(clInput_instance);
+			// save the data in the vector set, if it is in this process's shard
+			if (ullRead_ct % iShard_count == (unsigned long long)iShard_index)
+				vclInput_data.push_back(clInput_instance);
+			ullRead_ct++;
 
 		}// while
 
-		// allocate memory for the mean storage
-		vvfMeans.resize(iK_count);
-		vvfOld_means.resize(iK_count);
-
-		for (iCluster_index = 0; iCluster_index < iK_count; iCluster_index++){
-			// get the attribute
-			vvfMeans[iCluster_index].resize(iAttribute_ct);
-			vvfOld_means[iCluster_index].resize(iAttribute_ct);
-		} // for
+		szInstance_ct = vclInput_data.size();
+		Allocate_means();
 
 		bResult = true;
 	} //if
 	else {
-		cout << "Error reading " << sIn_file << endl << endl;
+		sError = "Error reading " + sIn_file;
+		cout << sError << endl << endl;
 		bResult = false;
 	}
 
@@ -278,13 +576,34 @@ bool Cluster_set::Read_input_data(void){
 	return bResult;
 } //Cluster_set::Read_input_data
 
+//***********************************************************************
+void Cluster_set::Allocate_means(void){
+
+	// local variables
+	int iCluster_index;
+
+	// allocate memory for the mean storage
+	vvfMeans.resize(iK_count);
+	vvfOld_means.resize(iK_count);
+
+	for (iCluster_index = 0; iCluster_index < iK_count; iCluster_index++){
+		// get the attribute
+		vvfMeans[iCluster_index].resize(iAttribute_ct);
+		vvfOld_means[iCluster_index].resize(iAttribute_ct);
+	} // for
+	vfDrift.assign(iK_count, 0);
+
+	return;
+} // Cluster_set::Allocate_means
+
 //***********************************************************************
 void Cluster_set::Write_output_data(void){
 
 	// local variables
 	unsigned uInstance_index;
 	int iCluster_index, iAttribute_index;
-	vector< vector<Cluster_instance> > vclThe_cluster_set(iK_count);
+	// indexes into vclInput_data, so the instances are not copied
+	vector< vector<unsigned> > vuThe_cluster_set(iK_count);
 
 	// declare an output stream
 	ofstream strResults_out_stream;
@@ -292,11 +611,16 @@ void Cluster_set::Write_output_data(void){
 	// Sort the cluster results
 	for (uInstance_index = 0; uInstance_index < vclInput_data.size(); uInstance_index++)
 	{
-		vclThe_cluster_set[vclInput_data[uInstance_index].iCluster].push_back(vclInput_data[uInstance_index]);
+		vuThe_cluster_set[vclInput_data[uInstance_index].iCluster].push_back(uInstance_index);
 	}
 
 	// open the stream to write the output plaintext
 	strResults_out_stream.open(sOut_file);
+	if (!strResults_out_stream.is_open()) {
+		sError = "Error writing " + sOut_file;
+		cout << sError << endl << endl;
+		return;
+	} // if
 
 	if(iK_count < 1) { // we have an empty cluster_set
 		cout << endl << "No clusters to send to output file!" << endl << endl;
@@ -310,20 +634,21 @@ void Cluster_set::Write_output_data(void){
 				strResults_out_stream << vvfMeans[iCluster_index][iAttribute_index] << " ";
 			} // for
 			strResults_out_stream << "and member count "
-				<< vclThe_cluster_set[iCluster_index].size() << "\n";
+				<< vuThe_cluster_set[iCluster_index].size() << "\n";
 
 			// loop thru the cluster members
 			for (uInstance_index = 0;
-				uInstance_index < vclThe_cluster_set[iCluster_index].size(); uInstance_index++){
+				uInstance_index < vuThe_cluster_set[iCluster_index].size(); uInstance_index++){
+
+				const Cluster_instance& clData_instance = vclInput_data[vuThe_cluster_set[iCluster_index][uInstance_index]];
 
 				// output the cluster member data
 				for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
-					strResults_out_stream
-						<< vclThe_cluster_set[iCluster_index][uInstance_index].vfAttribute[iAttribute_index];
+					strResults_out_stream << clData_instance.vfAttribute[iAttribute_index];
 					strResults_out_stream << " ";
 				} // for
 				strResults_out_stream << " ";
-				strResults_out_stream << vclThe_cluster_set[iCluster_index][uInstance_index].sClassification;
+				strResults_out_stream << vsLabels[clData_instance.uLabel];
 
 				// output a CR/LF
 				strResults_out_stream << "\n";
@@ -332,6 +657,14 @@ void Cluster_set::Write_output_data(void){
 			// output CR/LF
 			strResults_out_stream << "\n";
 		} // for
+
+		if (bHierarchical) {
+			Write_coarse_mapping(strResults_out_stream);
+		} // if
+
+		if (bLabel_report) {
+			Write_label_report(strResults_out_stream);
+		} // if
 	} // if
 
 	strResults_out_stream.close();
@@ -339,6 +672,123 @@ void Cluster_set::Write_output_data(void){
 	return;
 } // Cluster_set::Write_output_data
 
+//***********************************************************************
+// Returns the id of the label, adding it to the label table if it is new
+uint32_t Cluster_set::Intern_label(const string& sLabel){
+
+	// local variables
+	unordered_map<string, uint32_t>::iterator itLabel;
+	uint32_t uLabel;
+
+	itLabel = umLabel_ids.find(sLabel);
+	if (itLabel != umLabel_ids.end()) {
+		return itLabel->second;
+	} // if
+
+	uLabel = (uint32_t)vsLabels.size();
+	vsLabels.push_back(sLabel);
+	umLabel_ids[sLabel] = uLabel;
+
+	return uLabel;
+} // Cluster_set::Intern_label
+
+//***********************************************************************
+void Cluster_set::Label_histogram_process(unsigned uIndex, unsigned uLength, vector<unsigned>& vuHistogram){
+	// Counts the labels of each cluster into a k by label count histogram.
+
+	unsigned uLast = uIndex + uLength;
+	size_t szLabel_ct = vsLabels.size();
+
+	for (; uIndex < uLast; uIndex++) {
+		vuHistogram[vclInput_data[uIndex].iCluster * szLabel_ct + vclInput_data[uIndex].uLabel]++;
+	} // for
+} // Cluster_set::Label_histogram_process
+
+//***********************************************************************
+void Cluster_set::Write_label_report(ostream& strResults_out_stream){
+
+	// local variables
+	size_t szLabel_ct = vsLabels.size();
+	vector<unsigned> vuHistogram(iK_count * szLabel_ct);
+	unsigned uCluster_ct, uBest_ct, uTotal_best_ct = 0;
+	size_t szLabel_index;
+	int iCluster_index;
+
+	if (iNumThreads == 1)
+	{
+		//Don't bother creating more threads.
+		Label_histogram_process(0, vclInput_data.size(), vuHistogram);
+	}
+	else
+	{
+		// local variables
+		unsigned uPerThread;
+		unsigned uData;
+		unsigned uDataStart;
+		int iThread_index;
+		vector<thread> vtThreads;
+		// each thread counts into its own histogram
+		vector< vector<unsigned> > vvuThread_histograms(iNumThreads, vector<unsigned>(vuHistogram.size()));
+
+		uDataStart = 0;
+		uData = vclInput_data.size();
+		uPerThread = uData / iNumThreads;
+
+		//Split the dataset into parts and launch as individual
+		//threads.
+		for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+		{
+			//Force the last thread to take remaining data
+			if (iThread_index == iNumThreads - 1)
+			{
+				uPerThread = uData - uDataStart;
+			}
+
+			vector<unsigned>& vuThread_histogram = vvuThread_histograms[iThread_index];
+			vtThreads.push_back(thread([=, &vuThread_histogram](unsigned uStart, unsigned uLength) {
+				Label_histogram_process(uStart, uLength, vuThread_histogram); }, uDataStart, uPerThread));
+
+			uDataStart += uPerThread;
+		} // Launch all threads
+
+		//Wait for all threads to complete, then merge their histograms.
+		for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+		{
+			vtThreads[iThread_index].join();
+			for (szLabel_index = 0; szLabel_index < vuHistogram.size(); szLabel_index++)
+				vuHistogram[szLabel_index] += vvuThread_histograms[iThread_index][szLabel_index];
+		} // Wait for all threads
+	}
+
+	strResults_out_stream << "Label report\n";
+
+	// purity is the share of the cluster's members with its most common label
+	for (iCluster_index = 0; iCluster_index < iK_count; iCluster_index++){
+		uCluster_ct = 0;
+		uBest_ct = 0;
+		for (szLabel_index = 0; szLabel_index < szLabel_ct; szLabel_index++){
+			uCluster_ct += vuHistogram[iCluster_index * szLabel_ct + szLabel_index];
+			uBest_ct = max(uBest_ct, vuHistogram[iCluster_index * szLabel_ct + szLabel_index]);
+		} // for
+		uTotal_best_ct += uBest_ct;
+
+		strResults_out_stream << "Cluster #" << iCluster_index + 1 << " purity "
+			<< (uCluster_ct == 0 ? 0.0f : (float)uBest_ct / (float)uCluster_ct) << " labels";
+		for (szLabel_index = 0; szLabel_index < szLabel_ct; szLabel_index++){
+			if (vuHistogram[iCluster_index * szLabel_ct + szLabel_index] > 0) {
+				strResults_out_stream << " " << vsLabels[szLabel_index] << ":"
+					<< vuHistogram[iCluster_index * szLabel_ct + szLabel_index];
+			} // if
+		} // for
+		strResults_out_stream << "\n";
+	} // for
+
+	strResults_out_stream << "Overall purity "
+		<< (vclInput_data.empty() ? 0.0f : (float)uTotal_best_ct / (float)vclInput_data.size()) << "\n";
+
+	return;
+} // Cluster_set::Write_label_report
+
 //***********************************************************************
 float Cluster_set::Initialize_plus_plus_process(unsigned uIndex, unsigned uLength, int iSelectedPoints, vector<float>& vfDistance, const vector<bool>& vbSkipPoints) {
 
@@ -411,6 +861,7 @@ void Cluster_set::Initialize_plus_plus(void) {
 
 	// While we don't have enough starting clusters
 	for (; iSelectedPoints < iK_count; iSelectedPoints++) {
+		if (Seeding_out_of_time(iSelectedPoints)) break;
 		fTotalDistance = 0;
 
 		if (iNumPlusPlusThreads == 1)
@@ -481,18 +932,179 @@ void Cluster_set::Initialize_plus_plus(void) {
 	}
 } // Cluster_set::Initialize_plus_plus
 
+//***********************************************************************
+void Cluster_set::Initialize_afk_mc2_process(unsigned uIndex, unsigned uLength, int iSelectedPoints, const vector<size_t>& vszCandidates, vector<float>& vfDistance) {
+	// Computes the distance from each chain candidate to its nearest selected mean.
+
+	unsigned uLastIndex = uIndex + uLength;
+	int iAttribute_index;
+	int iK_index;
+	float fSum_of_squares;
+	float fDifference;
+
+	for (; uIndex < uLastIndex; uIndex++) {
+		const Cluster_instance& clData_instance = vclInput_data[vszCandidates[uIndex]];
+		vfDistance[uIndex] = FLT_MAX;
+		for (iK_index = 0; iK_index < iSelectedPoints; iK_index++) {
+			fSum_of_squares = 0;
+			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++) {
+				fDifference = (clData_instance.vfAttribute[iAttribute_index] - vvfMeans[iK_index][iAttribute_index]);
+				fSum_of_squares += (fDifference * fDifference);
+			} // for
+			if (fSum_of_squares < vfDistance[uIndex]) vfDistance[uIndex] = fSum_of_squares;
+		} // for
+	} // for
+} // Cluster_set::Initialize_afk_mc2_process
+
+//***********************************************************************
+void Cluster_set::Initialize_afk_mc2(void) {
+	// Initializes using AFK-MC2 (assumption free k-MC2), an approximation
+	// of k-means++. One pass over the data builds the proposal distribution
+	//   q(x) = d(x, c1)^2 / (2 * sum of d^2) + 1 / (2 * n)
+	// and each further center is the end of a Metropolis-Hastings chain of
+	// #afk-mc2-chain-length instances drawn from q, so only the chain's
+	// instances are compared against the selected means.
+
+	// Number of instances in the input data
+	size_t szData = vclInput_data.size();
+	size_t szIndex;
+	vector<double> vdCumulative(szData);
+	vector<double> vdProposal(szData);
+	vector<size_t> vszCandidates(max(iAfk_mc2_chain_length, 1));
+	vector<float> vfDistance(vszCandidates.size());
+	double dTotal = 0;
+	double dSum_of_squares, dDifference;
+	int iSelectedPoints, iAttribute_index, iStep;
+	size_t szCurrent;
+	float fCurrent_distance;
+
+	// The first center is chosen uniformly.
+	szCurrent = uniform_int_distribution<size_t>(0, szData - 1)(mtRandom);
+	for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+		vvfMeans[0][iAttribute_index] = vclInput_data[szCurrent].vfAttribute[iAttribute_index];
+	} // for
+
+	// Build the proposal distribution from the distances to it.
+	for (szIndex = 0; szIndex < szData; szIndex++) {
+		dSum_of_squares = 0;
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++) {
+			dDifference = vclInput_data[szIndex].vfAttribute[iAttribute_index] - vvfMeans[0][iAttribute_index];
+			dSum_of_squares += dDifference * dDifference;
+		} // for
+		vdProposal[szIndex] = dSum_of_squares;
+		dTotal += dSum_of_squares;
+	} // for
+	for (szIndex = 0; szIndex < szData; szIndex++) {
+		vdProposal[szIndex] = (dTotal > 0 ? 0.5 * vdProposal[szIndex] / dTotal : 0) + 0.5 / (double)szData;
+		vdCumulative[szIndex] = (szIndex > 0 ? vdCumulative[szIndex - 1] : 0) + vdProposal[szIndex];
+	} // for
+
+	for (iSelectedPoints = 1; iSelectedPoints < iK_count; iSelectedPoints++) {
+		if (Seeding_out_of_time(iSelectedPoints)) break;
+
+		// Draw the whole chain from q up front; the draws do not depend on
+		// the chain state, so their distances can be computed in parallel.
+		for (szIndex = 0; szIndex < vszCandidates.size(); szIndex++) {
+			vszCandidates[szIndex] = upper_bound(vdCumulative.begin(), vdCumulative.end(),
+				uniform_real_distribution<double>(0, vdCumulative.back())(mtRandom)) - vdCumulative.begin();
+			if (vszCandidates[szIndex] >= szData) vszCandidates[szIndex] = szData - 1;
+		} // for
+
+		if (iNumPlusPlusThreads == 1)
+		{
+			//Don't bother creating more threads.
+			Initialize_afk_mc2_process(0, vszCandidates.size(), iSelectedPoints, vszCandidates, vfDistance);
+		}
+		else
+		{
+			// local variables
+			unsigned uPerThread;
+			unsigned uDataStart;
+			int iThread_index;
+			vector<thread> vtThreads;
+
+			uDataStart = 0;
+			uPerThread = vszCandidates.size() / iNumPlusPlusThreads;
+
+			//Split the chain into parts and launch as individual
+			//threads.
+			for (iThread_index = 0; iThread_index < iNumPlusPlusThreads; iThread_index++)
+			{
+				//Force the last thread to take remaining data
+				if (iThread_index == iNumPlusPlusThreads - 1)
+				{
+					uPerThread = vszCandidates.size() - uDataStart;
+				}
+
+				vtThreads.push_back(thread([=, &vszCandidates, &vfDistance](unsigned uStart, unsigned uLength) {
+					Initialize_afk_mc2_process(uStart, uLength, iSelectedPoints, vszCandidates, vfDistance); }, uDataStart, uPerThread));
+
+				uDataStart += uPerThread;
+			} // Launch all threads
+
+			//Wait for all threads to complete.
+			for (iThread_index = 0; iThread_index < iNumPlusPlusThreads; iThread_index++)
+			{
+				vtThreads[iThread_index].join();
+			} // Wait for all threads
+		}
+
+		// Walk the chain, moving to a candidate with probability
+		// min(1, d(y)^2 q(x) / (d(x)^2 q(y))).
+		szCurrent = vszCandidates[0];
+		fCurrent_distance = vfDistance[0];
+		for (iStep = 1; iStep < (int)vszCandidates.size(); iStep++) {
+			if (fCurrent_distance <= 0
+				|| (double)vfDistance[iStep] * vdProposal[szCurrent]
+					> (double)fCurrent_distance * vdProposal[vszCandidates[iStep]] * uniform_real_distribution<double>(0, 1)(mtRandom)) {
+				szCurrent = vszCandidates[iStep];
+				fCurrent_distance = vfDistance[iStep];
+			} // if
+		} // for
+
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+			vvfMeans[iSelectedPoints][iAttribute_index] = vclInput_data[szCurrent].vfAttribute[iAttribute_index];
+		} // for
+	} // for
+} // Cluster_set::Initialize_afk_mc2
+
+//***********************************************************************
+// Returns the sum of squared distances from each instance to its mean
+double Cluster_set::Calculate_inertia(void){
+
+	// local variables
+	double dInertia = 0;
+	float fDifference;
+	unsigned uInstance_index;
+	int iAttribute_index;
+
+	for (uInstance_index = 0; uInstance_index < vclInput_data.size(); uInstance_index++) {
+		const Cluster_instance& clData_instance = vclInput_data[uInstance_index];
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++) {
+			fDifference = clData_instance.vfAttribute[iAttribute_index] - vvfMeans[clData_instance.iCluster][iAttribute_index];
+			dInertia += fDifference * fDifference;
+		} // for
+	} // for
+
+	return dInertia;
+} // Cluster_set::Calculate_inertia
+
 //***********************************************************************
 void Cluster_set::Identify_mean_values(void){
 
 	// local variables
 	int iCluster_index, iAttribute_index;
 	vector<float> vfValues;
+	chrono::steady_clock::time_point tpSeeding_start = chrono::steady_clock::now();
 
 	// allocate memory for the local vector
 	vfValues.resize(iAttribute_ct);
 
 	if (iIteration < 1) { // if this is the first iteration - initialize the cluster mean values
-		if (bUsePlusPlus) {
+		if (bUsePlusPlus && bUse_afk_mc2) {
+			Initialize_afk_mc2();
+		}
+		else if (bUsePlusPlus) {
 			Initialize_plus_plus();
 		}
 		else { // Use the first k instances.
@@ -503,6 +1115,7 @@ void Cluster_set::Identify_mean_values(void){
 				} // for
 			} //for
 		}
+		dSeeding_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - tpSeeding_start).count();
 	} // if
 
 	// save the existing mean values
@@ -518,12 +1131,14 @@ void Cluster_set::Identify_mean_values(void){
 } //Cluster_set::Identify_mean_values
 
 //***********************************************************************
-void Cluster_set::Cluster_data_process(unsigned uIndex, unsigned uLength)
+// Returns the number of instances that changed cluster
+unsigned Cluster_set::Cluster_data_process(unsigned uIndex, unsigned uLength, const vector< vector<float> >& vvfCluster_means)
 {
 	// local variables
+	unsigned uReassigned = 0;
 	float fDifference;
 	float fSquared_difference, fSum_of_squares;
-	float fBest_squared_difference;
+	float fBest_squared_difference, fSecond_squared_difference;
 	int iBest_index;
 	int iK_index, iAttribute_index;
 	unsigned uLast = uIndex + uLength;
@@ -533,11 +1148,30 @@ void Cluster_set::Cluster_data_process(unsigned uIndex, unsigned uLength)
 
 		// initialize the tracking variables
 		fBest_squared_difference = FLT_MAX; // make this erroneously big
+		fSecond_squared_difference = FLT_MAX;
 		iBest_index = -1; // Forces taking the first value
 
 		// get the next data vector
 		Cluster_instance& clData_instance = vclInput_data[uIndex];
 
+		if (bDrift_skip && clData_instance.iCluster >= 0) {
+			// widen the bounds by how far the means moved since they were set.
+			// while the assigned mean is still nearer than any other mean
+			// can be, the assignment cannot change
+			clData_instance.fUpper += vfDrift[clData_instance.iCluster];
+			clData_instance.fLower -= fMax_drift;
+			if (clData_instance.fUpper < clData_instance.fLower) continue;
+
+			// tighten the upper bound to the exact distance and check again
+			fSum_of_squares = 0;
+			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+				fDifference = (clData_instance.vfAttribute[iAttribute_index] - vvfCluster_means[clData_instance.iCluster][iAttribute_index]);
+				fSum_of_squares += fDifference * fDifference;
+			} // for
+			clData_instance.fUpper = sqrt(fSum_of_squares);
+			if (clData_instance.fUpper < clData_instance.fLower) continue;
+		} // if
+
 		// loop thru all of the mean values
 		for (iK_index = 0; iK_index < iK_count; iK_index++) {
 
@@ -548,7 +1182,7 @@ void Cluster_set::Cluster_data_process(unsigned uIndex, unsigned uLength)
 			// compare the data vector to the mean vector
 			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
 				// calculate the difference between the data value and the mean value
-				fDifference = (clData_instance.vfAttribute[iAttribute_index] - vvfMeans[iK_index][iAttribute_index]);
+				fDifference = (clData_instance.vfAttribute[iAttribute_index] - vvfCluster_means[iK_index][iAttribute_index]);
 				// square the difference
 				fSquared_difference = fDifference * fDifference;
 				// add to the sum of squares
@@ -557,17 +1191,27 @@ void Cluster_set::Cluster_data_process(unsigned uIndex, unsigned uLength)
 
 			// if this value is less than the best squared difference (BSD)
 			if (iBest_index == -1 || fSum_of_squares < fBest_squared_difference){
+				fSecond_squared_difference = fBest_squared_difference;
 				fBest_squared_difference = fSum_of_squares; // save it as BSD
 
 				// and save the this index as best index
 				iBest_index = iK_index;
 
 			} // if
+			else if (fSum_of_squares < fSecond_squared_difference){
+				fSecond_squared_difference = fSum_of_squares;
+			} // if
 		} // for
 
+		if (clData_instance.iCluster != iBest_index) uReassigned++;
 		clData_instance.iCluster = iBest_index;
+
+		// exact distances to the nearest and second nearest means
+		clData_instance.fUpper = sqrt(fBest_squared_difference);
+		clData_instance.fLower = sqrt(fSecond_squared_difference);
 	} // for
 
+	return uReassigned;
 } //Cluster_set::Cluster_data_process
 
 //***********************************************************************
@@ -575,7 +1219,7 @@ void Cluster_set::Cluster_data(void){
 	if (iNumThreads == 1)
 	{
 		//Don't bother creating more threads.
-		Cluster_data_process(0, vclInput_data.size());
+		uReassigned_ct = Cluster_data_process(0, vclInput_data.size(), vvfMeans);
 	}
 	else
 	{
@@ -584,7 +1228,15 @@ void Cluster_set::Cluster_data(void){
 		unsigned uData;
 		unsigned uDataStart;
 		int iThread_index;
-		vector<thread> vtThreads;
+		int iNode, iK_index;
+		vector<future<unsigned>> vtThreads;
+
+		// refresh each node's copy of the means
+		for (iNode = 0; iNode < iNuma_node_ct && iNuma_node_ct > 1; iNode++)
+		{
+			for (iK_index = 0; iK_index < iK_count; iK_index++)
+				copy(vvfMeans[iK_index].begin(), vvfMeans[iK_index].end(), vvvfNode_means[iNode][iK_index].begin());
+		}
 
 		uDataStart = 0;
 		uData = vclInput_data.size();
@@ -600,15 +1252,22 @@ void Cluster_set::Cluster_data(void){
 				uPerThread = uData - uDataStart;
 			}
 
-			vtThreads.push_back(thread([=](unsigned uStart, unsigned uLength) { Cluster_data_process(uStart, uLength); }, uDataStart, uPerThread));
+			iNode = Thread_node(iThread_index);
+			vtThreads.push_back(async(launch::async, [=](unsigned uStart, unsigned uLength) {
+				if (iNuma_node_ct == 1)
+					return Cluster_data_process(uStart, uLength, vvfMeans);
+				// work next to this slice of the data
+				Pin_thread_to_node(iNode);
+				return Cluster_data_process(uStart, uLength, vvvfNode_means[iNode]); }, uDataStart, uPerThread));
 
 			uDataStart += uPerThread;
 		} // Launch all threads
 
 		//Wait for all threads to complete.
+		uReassigned_ct = 0;
 		for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
 		{
-			vtThreads[iThread_index].join();
+			uReassigned_ct += vtThreads[iThread_index].get();
 		} // Wait for all threads
 	}
 	return;
@@ -618,54 +1277,150 @@ void Cluster_set::Cluster_data(void){
 void Cluster_set::Calculate_cluster_means(void){
 
 	// local variables
-	int iK_index, iAttribute_index;
-	unsigned uInstance_index, uInstance_sz;
-	vector<int> viCounts(iK_count);
+	int iK_index;
+	unsigned uInstance_sz;
+	// the means are rebuilt from the members' sums
+	vector<float> vfSums(iK_count * iAttribute_ct);
+	vector<unsigned> vuCounts(iK_count);
 
 	uInstance_sz = vclInput_data.size();
 	
-	for (uInstance_index = 0; uInstance_index < uInstance_sz; uInstance_index++)
+	if (iNuma_node_ct == 1)
 	{
-		iK_index = vclInput_data[uInstance_index].iCluster;
-		//loop through each vector attribute
-		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
-			vvfMeans[iK_index][iAttribute_index] += vclInput_data[uInstance_index].vfAttribute[iAttribute_index];
-		} // for
+		Calculate_cluster_means_process(0, uInstance_sz, vfSums, vuCounts);
+	}
+	else
+	{
+		// local variables
+		unsigned uPerThread;
+		unsigned uDataStart;
+		int iThread_index, iNode;
+		size_t szSum_index;
+		vector<thread> vtThreads;
+		// partial sums of each thread, then of each node
+		vector< vector<float> > vvfThread_sums(iNumThreads, vector<float>(iK_count * iAttribute_ct));
+		vector< vector<unsigned> > vvuThread_counts(iNumThreads, vector<unsigned>(iK_count));
+		vector< vector<float> > vvfNode_sums(iNuma_node_ct, vector<float>(iK_count * iAttribute_ct));
+		vector< vector<unsigned> > vvuNode_counts(iNuma_node_ct, vector<unsigned>(iK_count));
+
+		uDataStart = 0;
+		uPerThread = uInstance_sz / iNumThreads;
+
+		//Split the dataset the same way as Cluster_data, so each
+		//thread sums the slice held by its node.
+		for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+		{
+			//Force the last thread to take remaining data
+			if (iThread_index == iNumThreads - 1)
+			{
+				uPerThread = uInstance_sz - uDataStart;
+			}
 
-		viCounts[iK_index]++;
+			iNode = Thread_node(iThread_index);
+			vector<float>& vfThread_sums = vvfThread_sums[iThread_index];
+			vector<unsigned>& vuThread_counts = vvuThread_counts[iThread_index];
+			vtThreads.push_back(thread([=, &vfThread_sums, &vuThread_counts](unsigned uStart, unsigned uLength) {
+				Pin_thread_to_node(iNode);
+				Calculate_cluster_means_process(uStart, uLength, vfThread_sums, vuThread_counts); }, uDataStart, uPerThread));
+
+			uDataStart += uPerThread;
+		} // Launch all threads
+
+		//Wait for all threads, merging within each node first.
+		for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+		{
+			vtThreads[iThread_index].join();
+			iNode = Thread_node(iThread_index);
+			for (szSum_index = 0; szSum_index < vvfNode_sums[iNode].size(); szSum_index++)
+				vvfNode_sums[iNode][szSum_index] += vvfThread_sums[iThread_index][szSum_index];
+			for (iK_index = 0; iK_index < iK_count; iK_index++)
+				vvuNode_counts[iNode][iK_index] += vvuThread_counts[iThread_index][iK_index];
+		} // Wait for all threads
+
+		// then merge the nodes
+		for (iNode = 0; iNode < iNuma_node_ct; iNode++)
+		{
+			for (szSum_index = 0; szSum_index < vfSums.size(); szSum_index++)
+				vfSums[szSum_index] += vvfNode_sums[iNode][szSum_index];
+			for (iK_index = 0; iK_index < iK_count; iK_index++)
+				vuCounts[iK_index] += vvuNode_counts[iNode][iK_index];
+		}
 	}
 	
-	// loop thru each cluster
+	Finalize_cluster_means(vfSums, vuCounts, false);
+	for (iK_index = 0; iK_index < iK_count; iK_index++)
+		vvfMeans[iK_index].assign(vfSums.begin() + iK_index * iAttribute_ct, vfSums.begin() + (iK_index + 1) * iAttribute_ct);
+
+	return;
+} // Cluster_set::Calculate_cluster_means
+
+//***********************************************************************
+void Cluster_set::Calculate_cluster_means_process(unsigned uIndex, unsigned uLength, vector<float>& vfSums, vector<unsigned>& vuCounts){
+	// Sums the attributes of each cluster's members into vfSums, k by attribute count.
+
+	unsigned uLast = uIndex + uLength;
+	int iK_index, iAttribute_index;
+
+	for (; uIndex < uLast; uIndex++) {
+		iK_index = vclInput_data[uIndex].iCluster;
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+			vfSums[iK_index * iAttribute_ct + iAttribute_index] += vclInput_data[uIndex].vfAttribute[iAttribute_index];
+		} // for
+		vuCounts[iK_index]++;
+	} // for
+} // Cluster_set::Calculate_cluster_means_process
+
+//***********************************************************************
+void Cluster_set::Finalize_cluster_means(vector<float>& vfSums, const vector<unsigned>& vuCounts, bool bBy_attribute){
+	// Divides each cluster's sums by its member count, in place. vfSums is k
+	// by attribute count, or attribute count by k when bBy_attribute. A
+	// cluster with no members moves to the origin, as in the original code.
+
+	// local variables
+	int iK_index, iAttribute_index;
+	size_t szSum_index;
+
 	for (iK_index = 0; iK_index < iK_count; iK_index++){
-		//loop through each vector attribute
 		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++) {
-			//If no elements, default to origin as per old code.
-			if (viCounts[iK_index] == 0)
-				vvfMeans[iK_index][iAttribute_index] = 0;
+			if (bBy_attribute)
+				szSum_index = (size_t)iAttribute_index * iK_count + iK_index;
 			else
-				vvfMeans[iK_index][iAttribute_index] /= (float)viCounts[iK_index];
-		}
+				szSum_index = (size_t)iK_index * iAttribute_ct + iAttribute_index;
+
+			if (vuCounts[iK_index] == 0)
+				vfSums[szSum_index] = 0;
+			else
+				vfSums[szSum_index] /= (float)vuCounts[iK_index];
+		} // for
 	} // for
 
 	return;
-} // Cluster_set::Calculate_cluster_means
+} // Cluster_set::Finalize_cluster_means
 
 //***********************************************************************
 bool Cluster_set::Compare_mean_values(void){
 
 	// local variables
-	bool bNot_done;
 	float sStep_difference;
 	float fResult_difference = 0;
+	float fDrift_squares;
 	int iCluster_index, iAttribute_index;
 
+	fMax_drift = 0;
+
 	// calculate the difference between the old means and the new means
 	for (iCluster_index = 0; iCluster_index < iK_count; iCluster_index++){ // by each cluster
+		fDrift_squares = 0;
+
 		// compare the attribute mean values
 		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
 
 			sStep_difference = vvfMeans[iCluster_index][iAttribute_index]
 				- vvfOld_means[iCluster_index][iAttribute_index];
+
+			// record the distance moved for the drift bounds
+			fDrift_squares += sStep_difference * sStep_difference;
+
 			// guarantee a positive value without using squares
 			if (sStep_difference < 0) sStep_difference = sStep_difference * (-1);
 
@@ -674,14 +1429,30 @@ bool Cluster_set::Compare_mean_values(void){
 
 		} // for
 
+		vfDrift[iCluster_index] = sqrt(fDrift_squares);
+		if (vfDrift[iCluster_index] > fMax_drift) fMax_drift = vfDrift[iCluster_index];
 	} // for
 
+	return Not_converged(fResult_difference);
+
+} // Cluster_set::Compare_mean_values
+
+//***********************************************************************
+// Returns true while clustering should go on, given the summed change of the means
+bool Cluster_set::Not_converged(float fResult_difference){
+
+	// local variables
+	bool bNot_done;
+
 	// stop clustering if there is little change in  the mean values
 	if (fResult_difference < fTolerance) bNot_done = false;
 	else bNot_done = true;
 
-	return bNot_done;
+	// or if few instances changed cluster in the last pass
+	if (fReassign_tolerance >= 0
+		&& (float)uReassigned_ct <= fReassign_tolerance * (float)szInstance_ct) bNot_done = false;
 
-} // Cluster_set::Compare_mean_values
+	return bNot_done;
+} // Cluster_set::Not_converged
 
 //***********************************************************************
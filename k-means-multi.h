@@ -15,13 +15,50 @@
 //
 //			   control labels: #k-count, #input-filename, #output-filename, #use-labels,
 //				 #tolerance, #plus-plus, #plus-plus-threads, #plus-plus-random-seed,
-//				 #num-threads, #EOF
+//				 #num-threads, #online, #online-learning-rate, #online-snapshot-interval,
+//				 #online-reservoir-size, #online-dead-after, #online-warmup, #label-report,
+//				 #reassign-tolerance, #max-iterations, #time-budget-ms, #drift-skip,
+//				 #numa, #distributed-role, #distributed-address, #distributed-workers,
+//				 #parallel-rounds, #parallel-oversampling, #afk-mc2, #afk-mc2-chain-length,
+//				 #report-stats, #hierarchical, #coarse-k-count, #hierarchical-refine,
+//				 #hierarchical-neighbours, #sparse-input, #server, #server-address,
+//				 #server-watch-directory, #server-threads, #server-cache-mb,
+//				 #server-poll-ms, #EOF
 //
 //             values: k value = integer, input datafile name = string,
 //				 output datafile name = string, use data labels = boolean (1, 0),
 //				 stopping tolerance value = float, use k-means++ = boolean (1, 0),
 //				 number of k-means++ threads = integer, random seed for k-means++ = integer,
-//				 number of threads = integer, eof = no value
+//				 number of threads = integer, use online mode = boolean (1, 0),
+//				 online learning rate = float (0 for count based),
+//				 points between snapshots = integer, reservoir sample size = integer,
+//				 points before an idle cluster is respawned = integer,
+//				 points the means are seeded from = integer (0 for 10 times k),
+//				 write a label histogram and purity report = boolean (1, 0),
+//				 stopping fraction of reassigned instances = float (negative to disable),
+//				 maximum iterations = integer (0 for no limit),
+//				 time budget in milliseconds = integer (0 for no limit),
+//				 skip stable instances using mean drift bounds = boolean (1, 0),
+//				 place data and threads by NUMA node = boolean (1, 0),
+//				 distributed role = string (coordinator, worker),
+//				 distributed address = string (host:port or unix:path),
+//				 number of distributed workers = integer,
+//				 k-means|| seeding rounds = integer,
+//				 k-means|| candidates per round as a multiple of k = float,
+//				 use AFK-MC2 approximate k-means++ seeding = boolean (1, 0),
+//				 AFK-MC2 markov chain length = integer,
+//				 print seeding time and final inertia = boolean (1, 0),
+//				 use two level k-means = boolean (1, 0),
+//				 number of coarse clusters = integer (0 for the square root of k),
+//				 global refinement iterations = integer,
+//				 coarse cells searched by the refinement = integer,
+//				 read index:value sparse input = boolean (1, 0),
+//				 run as a job server = boolean (1, 0),
+//				 server address = string (host:port or unix:path),
+//				 directory watched for control files = string,
+//				 threads shared by the server's jobs = integer (0 for one per cpu),
+//				 dataset cache size in megabytes = integer (0 to disable),
+//				 milliseconds between directory scans = integer, eof = no value
 //
 //        <datafile.dat> - classification set - filename specified in the control file
 //             attribute count - don't include the classification in
@@ -54,9 +91,14 @@
 #include <string>
 #include <vector>
 #include <random>
+#include <unordered_map>
+#include <cstdint>
+#include <chrono>
 
 using namespace std;
 
+class Dataset_cache;
+
 //***********************************************************************
 // class Cluster_instance declaration
 // An instance of data in the clustering system.
@@ -70,8 +112,10 @@ class Cluster_instance {
 public:
 	// public class variables
 	vector<float> vfAttribute;
-	string sClassification;
+	uint32_t uLabel; // index into Cluster_set::vsLabels
 	int iCluster;
+	float fUpper; // bound on the distance to the assigned mean
+	float fLower; // bound on the distance to the second nearest mean
 
 	// public methods
 	Cluster_instance(void); // constructor
@@ -98,17 +142,107 @@ class Cluster_set {
 	mt19937 mtRandom;
 	int iNumPlusPlusThreads;
 	int iNumThreads;
+	bool bUseOnline;
+	float fOnline_learning_rate;
+	int iOnline_snapshot_interval;
+	int iOnline_reservoir_size;
+	int iOnline_dead_after;
+	int iOnline_warmup;
+	vector<string> vsLabels; // interned classification names
+	unordered_map<string, uint32_t> umLabel_ids;
+	bool bLabel_report;
+	float fReassign_tolerance;
+	unsigned uReassigned_ct; // instances that changed cluster in the last pass
+	int iMax_iterations;
+	int iTime_budget_ms;
+	bool bDrift_skip;
+	vector<float> vfDrift; // distance each mean moved in the last iteration
+	float fMax_drift;
+	bool bUseNuma;
+	int iNuma_node_ct; // 1 unless the data is placed by node
+	vector< vector<int> > vviNuma_cpus; // usable cpus of each node
+	vector< vector< vector<float> > > vvvfNode_means; // per node copies of the means
+	size_t szInstance_ct; // instances being clustered, across all workers
+	chrono::steady_clock::time_point tpClustering_start;
+	string sDistributed_role;
+	string sDistributed_address;
+	int iDistributed_workers;
+	int iShard_index; // this process keeps instances where index % count == shard
+	int iShard_count;
+	int iParallel_rounds;
+	float fParallel_oversampling;
+	bool bUse_afk_mc2;
+	int iAfk_mc2_chain_length;
+	bool bReport_stats;
+	double dSeeding_ms;
+	bool bHierarchical;
+	int iCoarse_k_count;
+	int iHierarchical_refine;
+	int iHierarchical_neighbours;
+	vector< vector<float> > vvfCoarse_means;
+	vector<int> viFine_coarse; // coarse cluster of each fine cluster
+	bool bQuiet; // part of a larger run - don't print budget messages
+	bool bSparse_input;
+	vector<size_t> vszRow_start; // CSR storage of sparse instances
+	vector<uint32_t> vuColumn;
+	vector<float> vfValue;
+	vector<float> vfRow_norm; // squared norm of each sparse instance
+	bool bServer;
+	string sServer_address;
+	string sServer_watch_directory;
+	int iServer_threads;
+	int iServer_cache_mb;
+	int iServer_poll_ms;
+	Dataset_cache* pclDataset_cache; // shared by the jobs of the server mode
+	string sCache_status; // hit or miss when the input came from the cache
+	string sError; // why the run failed, empty if it succeeded
 
 	// private methods
 	bool Read_input_data(void);
+	void Allocate_means(void);
+	bool Budget_exhausted(void);
+	bool Past_time_budget(void);
+	bool Seeding_out_of_time(int iSelected_points);
+	void Run_clustering(void);
 	void Write_output_data(void);
+	uint32_t Intern_label(const string& sLabel);
+	void Label_histogram_process(unsigned uIndex, unsigned uLength, vector<unsigned>& vuHistogram);
+	void Write_label_report(ostream& strResults_out_stream);
 	float Initialize_plus_plus_process(unsigned uIndex, unsigned uLength, int iSelectedPoints, vector<float>& vfDistance, const vector<bool>& vbSkipPoints);
 	void Initialize_plus_plus(void);
+	void Initialize_afk_mc2_process(unsigned uIndex, unsigned uLength, int iSelectedPoints, const vector<size_t>& vszCandidates, vector<float>& vfDistance);
+	void Initialize_afk_mc2(void);
+	double Calculate_inertia(void);
 	void Identify_mean_values(void);
 	void Cluster_data(void);
-	void Cluster_data_process(unsigned uIndex, unsigned uLength);
+	unsigned Cluster_data_process(unsigned uIndex, unsigned uLength, const vector< vector<float> >& vvfCluster_means);
 	void Calculate_cluster_means(void);
+	void Calculate_cluster_means_process(unsigned uIndex, unsigned uLength, vector<float>& vfSums, vector<unsigned>& vuCounts);
+	void Finalize_cluster_means(vector<float>& vfSums, const vector<unsigned>& vuCounts, bool bBy_attribute);
+	void Detect_numa_nodes(void);
+	void Place_input_data_numa(void);
+	void Pin_thread_to_node(int iNode);
+	int Thread_node(int iThread_index);
+	void Execute_distributed_coordinator(void);
+	void Execute_distributed_worker(void);
+	bool Distributed_plus_plus(const vector<int>& viWorker_fds);
+	bool Distributed_fetch(const vector<int>& viWorker_fds, unsigned long long ullGlobal_index, vector<float>& vfInstance);
+	void Execute_hierarchical_clustering(void);
+	unsigned Hierarchical_refine_process(unsigned uIndex, unsigned uLength, const vector<int>& viInstance_coarse, const vector< vector<int> >& vviCoarse_candidates);
+	void Write_coarse_mapping(ostream& strResults_out_stream);
+	bool Read_sparse_input_data(void);
+	void Execute_sparse_clustering(void);
+	unsigned Cluster_sparse_data_process(unsigned uIndex, unsigned uLength, const vector<float>& vfMeans_by_attribute, const vector<float>& vfMean_norms);
+	void Sparse_plus_plus(void);
+	void Write_sparse_output_data(void);
+	bool Read_cached_input_data(void);
+	void Execute_server(void);
 	bool Compare_mean_values(void);
+	bool Not_converged(float fResult_difference);
+	void Execute_online_clustering(void);
+	void Online_seed_means(const vector<float>& vfWarmup, unsigned uWarmup_ct, vector<unsigned long long>& vullCounts);
+	void Online_respawn_cluster(int iK_index, const vector<float>& vfReservoir, unsigned uReservoir_ct);
+	void Write_online_snapshot(ostream& strResults_out_stream, unsigned long long ullPoints, const vector<unsigned long long>& vullCounts);
 
 public:
 	// public class variables
@@ -120,3 +254,9 @@ public:
 
 }; // class Cluster_set
 
+//***********************************************************************
+// socket helpers shared by the distributed and server modes
+//***********************************************************************
+int Socket_open(const string& sAddress, bool bListen);
+bool Send_all(int iFd, const void* pvData, size_t szLength);
+
@@ -0,0 +1,190 @@
+//***********************************************************************
+// k-means-numa.cpp
+//
+//   this is the NUMA placement for the K-means classification algorithm.
+//   on machines with more than one NUMA node the input data is split into
+//   the same slices the worker threads use, each slice is copied by a thread
+//   pinned to a node so its memory is first touched on that node, and each
+//   node gets its own copy of the means
+//
+// INVOKE APPLICATION USING: k-means++ <control file name>
+//   with #num-threads greater than 1. #numa 0 disables the placement
+//
+//***********************************************************************
+//  WARNING: nodes are read from sysfs and threads are pinned with
+//           sched_setaffinity, so this only has an effect on Linux.
+//           single node machines are left alone
+//
+//***********************************************************************
+// Copyright 2014 Isaac Brodsky
+//
+//***********************************************************************
+
+#include "k-means-multi.h"
+#include <fstream>
+#include <thread>
+#include <cstdlib>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+//***********************************************************************
+// Parses a sysfs cpu or node list such as "0-3,8-11"
+static vector<int> Parse_sysfs_list(const string& sList){
+
+	// local variables
+	vector<int> viResult;
+	const char* pcCursor = sList.c_str();
+	char* pcEnd;
+	long lFirst, lLast;
+
+	while (*pcCursor != '\0') {
+		lFirst = strtol(pcCursor, &pcEnd, 10);
+		if (pcEnd == pcCursor) break; // no number to read
+		lLast = lFirst;
+		if (*pcEnd == '-') {
+			pcCursor = pcEnd + 1;
+			lLast = strtol(pcCursor, &pcEnd, 10);
+		} // if
+		for (; lFirst <= lLast; lFirst++) viResult.push_back((int)lFirst);
+		pcCursor = pcEnd;
+		if (*pcCursor == ',') pcCursor++;
+	} // while
+
+	return viResult;
+} // Parse_sysfs_list
+
+//***********************************************************************
+// class Cluster_set NUMA method declarations
+//***********************************************************************
+void Cluster_set::Detect_numa_nodes(void){
+	// Fills vviNuma_cpus with the cpus of each online node that this
+	// process is allowed to run on.
+
+	vviNuma_cpus.clear();
+
+#ifdef __linux__
+	// local variables
+	ifstream strList_stream;
+	string sList;
+	vector<int> viNodes, viCpus, viAllowed_cpus;
+	cpu_set_t csAllowed;
+	unsigned uNode_index, uCpu_index;
+
+	if (sched_getaffinity(0, sizeof(csAllowed), &csAllowed) != 0) return;
+
+	strList_stream.open("/sys/devices/system/node/online");
+	if (!strList_stream.is_open() || !getline(strList_stream, sList)) return;
+	strList_stream.close();
+	viNodes = Parse_sysfs_list(sList);
+
+	for (uNode_index = 0; uNode_index < viNodes.size(); uNode_index++) {
+		strList_stream.open("/sys/devices/system/node/node" + to_string(viNodes[uNode_index]) + "/cpulist");
+		sList.clear();
+		if (strList_stream.is_open()) getline(strList_stream, sList);
+		strList_stream.close();
+		strList_stream.clear();
+
+		viCpus = Parse_sysfs_list(sList);
+		viAllowed_cpus.clear();
+		for (uCpu_index = 0; uCpu_index < viCpus.size(); uCpu_index++) {
+			if (viCpus[uCpu_index] < CPU_SETSIZE && CPU_ISSET(viCpus[uCpu_index], &csAllowed))
+				viAllowed_cpus.push_back(viCpus[uCpu_index]);
+		} // for
+
+		// memory only nodes have no cpus to run workers on
+		if (!viAllowed_cpus.empty()) vviNuma_cpus.push_back(viAllowed_cpus);
+	} // for
+#endif
+
+	return;
+} // Cluster_set::Detect_numa_nodes
+
+//***********************************************************************
+void Cluster_set::Place_input_data_numa(void){
+
+	// local variables
+	unsigned uPerThread;
+	unsigned uData;
+	unsigned uDataStart;
+	int iThread_index, iNode;
+	vector<thread> vtThreads;
+
+	iNuma_node_ct = 1;
+	if (!bUseNuma || iNumThreads < 2) return;
+
+	Detect_numa_nodes();
+	if (vviNuma_cpus.size() < 2) return; // nothing to do on a single node
+
+	iNuma_node_ct = min((int)vviNuma_cpus.size(), iNumThreads);
+
+	uDataStart = 0;
+	uData = vclInput_data.size();
+	uPerThread = uData / iNumThreads;
+
+	//Split the dataset the same way as Cluster_data and copy each
+	//slice from a thread on the node that will cluster it.
+	for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+	{
+		//Force the last thread to take remaining data
+		if (iThread_index == iNumThreads - 1)
+		{
+			uPerThread = uData - uDataStart;
+		}
+
+		iNode = Thread_node(iThread_index);
+		vtThreads.push_back(thread([=](unsigned uStart, unsigned uLength) {
+			Pin_thread_to_node(iNode);
+			for (unsigned uIndex = uStart; uIndex < uStart + uLength; uIndex++) {
+				vector<float> vfLocal(vclInput_data[uIndex].vfAttribute);
+				vclInput_data[uIndex].vfAttribute.swap(vfLocal);
+			} }, uDataStart, uPerThread));
+
+		uDataStart += uPerThread;
+	} // Launch all threads
+
+	// allocate each node's copy of the means on that node
+	vvvfNode_means.resize(iNuma_node_ct);
+	for (iNode = 0; iNode < iNuma_node_ct; iNode++)
+	{
+		vtThreads.push_back(thread([=]() {
+			Pin_thread_to_node(iNode);
+			vvvfNode_means[iNode].assign(iK_count, vector<float>(iAttribute_ct)); }));
+	}
+
+	//Wait for all threads to complete.
+	for (iThread_index = 0; iThread_index < (int)vtThreads.size(); iThread_index++)
+	{
+		vtThreads[iThread_index].join();
+	} // Wait for all threads
+
+	return;
+} // Cluster_set::Place_input_data_numa
+
+//***********************************************************************
+void Cluster_set::Pin_thread_to_node(int iNode){
+	// Restricts the calling thread to the cpus of a node.
+
+#ifdef __linux__
+	// local variables
+	cpu_set_t csNode;
+	unsigned uCpu_index;
+
+	CPU_ZERO(&csNode);
+	for (uCpu_index = 0; uCpu_index < vviNuma_cpus[iNode].size(); uCpu_index++) {
+		CPU_SET(vviNuma_cpus[iNode][uCpu_index], &csNode);
+	} // for
+	sched_setaffinity(0, sizeof(csNode), &csNode);
+#endif
+
+	return;
+} // Cluster_set::Pin_thread_to_node
+
+//***********************************************************************
+// Returns the node holding a worker thread's slice of the data
+int Cluster_set::Thread_node(int iThread_index){
+
+	return iThread_index * iNuma_node_ct / iNumThreads;
+} // Cluster_set::Thread_node
+
+//***********************************************************************
@@ -0,0 +1,370 @@
+//***********************************************************************
+// k-means-online.cpp
+//
+//   this is the online (sequential) mode of the K-means classification algorithm.
+//   it reads instances from an unbounded stream (a file, FIFO or stdin),
+//   seeds the means k-means++ style from a warm-up sample and then updates
+//   the cluster means incrementally as each instance arrives
+//
+// INVOKE APPLICATION USING: k-means++ <control file name>
+//   with #online 1 in the control file
+//
+// INPUTS: (from stream)
+//        <datafile.dat> - same format as the batch mode. an input filename of
+//             "-" reads from stdin. any classification after the attributes
+//             is ignored
+//
+// OUTPUTS: (to disk file)
+//        <output_filename> - a snapshot of the cluster means and member counts
+//             every #online-snapshot-interval instances and at the end of the
+//             stream. an output filename of "-" writes to stdout
+//
+//***********************************************************************
+//  WARNING: instances are not retained, so no member listing is written
+//
+//***********************************************************************
+// Copyright 2014 Isaac Brodsky
+//
+//***********************************************************************
+
+#include "k-means-multi.h"
+#include <fstream>
+#include <cfloat>
+#include <cstdlib>
+
+//***********************************************************************
+// class Cluster_set online method declarations
+//***********************************************************************
+void Cluster_set::Execute_online_clustering(void){
+
+	// local variables
+	istream* pstrInput_stream;
+	ostream* pstrResults_out_stream;
+	ifstream strFile_stream;
+	ofstream strResults_file_stream;
+	string sLine;
+	const char* pcCursor;
+	char* pcEnd;
+	vector<float> vfPoint;
+	vector<float> vfReservoir;
+	vector<float> vfWarmup;
+	vector<unsigned long long> vullCounts(iK_count);
+	vector<unsigned long long> vullLast_update(iK_count);
+	unsigned long long ullPoints = 0;
+	unsigned long long ullSlot;
+	unsigned uReservoir_ct = 0;
+	unsigned uWarmup_size, uWarmup_ct = 0;
+	bool bSeeded = false;
+	int iK_index, iAttribute_index, iBest_index;
+	float fDifference, fSum_of_squares, fBest_squared_difference;
+	float fRate;
+	float* pfMean;
+
+	// negative sizes and intervals turn the feature off, like 0
+	if (iOnline_reservoir_size < 0 || iOnline_dead_after < 0 || iOnline_snapshot_interval < 0) {
+		cout << "Negative online settings are treated as 0." << endl;
+		iOnline_reservoir_size = max(iOnline_reservoir_size, 0);
+		iOnline_dead_after = max(iOnline_dead_after, 0);
+		iOnline_snapshot_interval = max(iOnline_snapshot_interval, 0);
+	} // if
+
+	// open the input stream, "-" is stdin
+	if (sIn_file == "-") {
+		ios::sync_with_stdio(false);
+		pstrInput_stream = &cin;
+	}
+	else {
+		strFile_stream.open(sIn_file.c_str());
+		if (!strFile_stream.is_open()) {
+			sError = "Error reading " + sIn_file;
+			cout << sError << endl << endl;
+			return;
+		}
+		pstrInput_stream = &strFile_stream;
+	} // if
+
+	// the stream starts with the attribute count like the batch input
+	*pstrInput_stream >> iAttribute_ct;
+	if (pstrInput_stream->fail() || iAttribute_ct < 1) {
+		sError = "Error reading the attribute count from " + sIn_file;
+		cout << sError << endl << endl;
+		return;
+	}
+	getline(*pstrInput_stream, sLine); // skip the rest of the header line
+
+	// open the output stream, "-" is stdout
+	if (sOut_file == "-") {
+		pstrResults_out_stream = &cout;
+	}
+	else {
+		strResults_file_stream.open(sOut_file);
+		if (!strResults_file_stream.is_open()) {
+			sError = "Error writing " + sOut_file;
+			cout << sError << endl << endl;
+			return;
+		}
+		pstrResults_out_stream = &strResults_file_stream;
+	} // if
+
+	// allocate memory for the means, the current point and the reservoir
+	vvfMeans.assign(iK_count, vector<float>(iAttribute_ct));
+	vfPoint.resize(iAttribute_ct);
+	if (iOnline_reservoir_size > 0)
+		vfReservoir.resize((size_t)iOnline_reservoir_size * iAttribute_ct);
+	uWarmup_size = (unsigned)max(iOnline_warmup > 0 ? iOnline_warmup : 10 * iK_count, iK_count);
+	vfWarmup.reserve((size_t)uWarmup_size * iAttribute_ct);
+
+	while (getline(*pstrInput_stream, sLine)) {
+
+		// parse the attributes, the classification (if any) is ignored
+		pcCursor = sLine.c_str();
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+			vfPoint[iAttribute_index] = strtof(pcCursor, &pcEnd);
+			if (pcEnd == pcCursor) break; // no number to read
+			pcCursor = pcEnd;
+		} // for
+		if (iAttribute_index < iAttribute_ct) continue; // blank or short line
+
+		ullPoints++;
+
+		// keep a uniform reservoir sample of the stream to respawn clusters from
+		if (uReservoir_ct < (unsigned)iOnline_reservoir_size) {
+			copy(vfPoint.begin(), vfPoint.end(), vfReservoir.begin() + (size_t)uReservoir_ct * iAttribute_ct);
+			uReservoir_ct++;
+		}
+		else if (iOnline_reservoir_size > 0) {
+			ullSlot = uniform_int_distribution<unsigned long long>(0, ullPoints - 1)(mtRandom);
+			if (ullSlot < (unsigned long long)iOnline_reservoir_size) {
+				copy(vfPoint.begin(), vfPoint.end(), vfReservoir.begin() + (size_t)ullSlot * iAttribute_ct);
+			}
+		} // if
+
+		if (!bSeeded) {
+			// keep the first instances to seed the means from
+			vfWarmup.insert(vfWarmup.end(), vfPoint.begin(), vfPoint.end());
+			uWarmup_ct++;
+			if (uWarmup_ct == uWarmup_size) {
+				Online_seed_means(vfWarmup, uWarmup_ct, vullCounts);
+				vullLast_update.assign(iK_count, ullPoints);
+				vector<float>().swap(vfWarmup);
+				bSeeded = true;
+			} // if
+		}
+		else {
+			// find the nearest mean
+			fBest_squared_difference = FLT_MAX;
+			iBest_index = 0;
+			for (iK_index = 0; iK_index < iK_count; iK_index++) {
+				pfMean = vvfMeans[iK_index].data();
+				fSum_of_squares = 0;
+				for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+					fDifference = vfPoint[iAttribute_index] - pfMean[iAttribute_index];
+					fSum_of_squares += fDifference * fDifference;
+				} // for
+				if (fSum_of_squares < fBest_squared_difference) {
+					fBest_squared_difference = fSum_of_squares;
+					iBest_index = iK_index;
+				} // if
+			} // for
+
+			// move the mean toward the point. a count based rate keeps the
+			// mean equal to the running average, a fixed rate decays old points
+			vullCounts[iBest_index]++;
+			vullLast_update[iBest_index] = ullPoints;
+			if (fOnline_learning_rate > 0)
+				fRate = fOnline_learning_rate;
+			else
+				fRate = 1.0f / (float)vullCounts[iBest_index];
+
+			pfMean = vvfMeans[iBest_index].data();
+			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+				pfMean[iAttribute_index] += fRate * (vfPoint[iAttribute_index] - pfMean[iAttribute_index]);
+			} // for
+		} // if
+
+		// respawn clusters that have not been updated recently
+		if (iOnline_dead_after > 0 && bSeeded
+			&& ullPoints % (unsigned long long)iOnline_dead_after == 0) {
+			for (iK_index = 0; iK_index < iK_count; iK_index++) {
+				if (ullPoints - vullLast_update[iK_index] >= (unsigned long long)iOnline_dead_after) {
+					Online_respawn_cluster(iK_index, vfReservoir, uReservoir_ct);
+					vullCounts[iK_index] = 1;
+					vullLast_update[iK_index] = ullPoints;
+				} // if
+			} // for
+		} // if
+
+		// no snapshots until the means are seeded
+		if (iOnline_snapshot_interval > 0 && bSeeded
+			&& ullPoints % (unsigned long long)iOnline_snapshot_interval == 0) {
+			Write_online_snapshot(*pstrResults_out_stream, ullPoints, vullCounts);
+		} // if
+	} // while
+
+	// a short stream is seeded from what arrived
+	if (!bSeeded && uWarmup_ct > 0) {
+		Online_seed_means(vfWarmup, uWarmup_ct, vullCounts);
+	} // if
+
+	if (ullPoints < (unsigned long long)iK_count) {
+		cout << "Stream ended after " << ullPoints << " instances, fewer than the "
+			<< iK_count << " clusters requested." << endl;
+	} // if
+
+	// always finish with the final means
+	if (iOnline_snapshot_interval <= 0 || ullPoints == 0
+		|| ullPoints % (unsigned long long)iOnline_snapshot_interval != 0) {
+		Write_online_snapshot(*pstrResults_out_stream, ullPoints, vullCounts);
+	} // if
+
+	strResults_file_stream.close();
+
+	return;
+} // Cluster_set::Execute_online_clustering
+
+//***********************************************************************
+void Cluster_set::Online_seed_means(const vector<float>& vfWarmup, unsigned uWarmup_ct, vector<unsigned long long>& vullCounts){
+	// Seeds the means with k-means++ over the warm-up instances, then moves
+	// each mean to the average of the warm-up instances nearest it.
+
+	// local variables
+	vector<float> vfDistance(uWarmup_ct, FLT_MAX);
+	vector<float> vfSums((size_t)iK_count * iAttribute_ct, 0);
+	unsigned uIndex;
+	int iK_index, iSeeded_ct, iAttribute_index, iBest_index;
+	float fDifference, fSum_of_squares, fBest_squared_difference;
+	float fTotalDistance, fRandomDistance;
+	const float* pfPoint;
+
+	// the first mean is a uniform choice
+	uIndex = uniform_int_distribution<unsigned>(0, uWarmup_ct - 1)(mtRandom);
+	vvfMeans[0].assign(vfWarmup.begin() + (size_t)uIndex * iAttribute_ct, vfWarmup.begin() + (size_t)(uIndex + 1) * iAttribute_ct);
+
+	for (iSeeded_ct = 1; iSeeded_ct < iK_count; iSeeded_ct++) {
+		// distance to the nearest mean so far
+		fTotalDistance = 0;
+		for (uIndex = 0; uIndex < uWarmup_ct; uIndex++) {
+			pfPoint = vfWarmup.data() + (size_t)uIndex * iAttribute_ct;
+			fSum_of_squares = 0;
+			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+				fDifference = pfPoint[iAttribute_index] - vvfMeans[iSeeded_ct - 1][iAttribute_index];
+				fSum_of_squares += fDifference * fDifference;
+			} // for
+			if (fSum_of_squares < vfDistance[uIndex]) vfDistance[uIndex] = fSum_of_squares;
+			fTotalDistance += vfDistance[uIndex];
+		} // for
+
+		// every instance sits on a mean, so the rest repeat the first. they
+		// never win an instance and are respawned once they count as idle
+		if (fTotalDistance <= 0) break;
+
+		fRandomDistance = uniform_real_distribution<float>(0, fTotalDistance)(mtRandom);
+		for (uIndex = 0; uIndex < uWarmup_ct; uIndex++) {
+			fRandomDistance -= vfDistance[uIndex];
+			if (fRandomDistance <= 0 || uIndex == uWarmup_ct - 1) break;
+		} // for
+		pfPoint = vfWarmup.data() + (size_t)uIndex * iAttribute_ct;
+		vvfMeans[iSeeded_ct].assign(pfPoint, pfPoint + iAttribute_ct);
+	} // for
+	for (; iSeeded_ct < iK_count; iSeeded_ct++) vvfMeans[iSeeded_ct] = vvfMeans[0];
+
+	// one batch iteration over the warm-up instances
+	vullCounts.assign(iK_count, 0);
+	for (uIndex = 0; uIndex < uWarmup_ct; uIndex++) {
+		pfPoint = vfWarmup.data() + (size_t)uIndex * iAttribute_ct;
+		fBest_squared_difference = FLT_MAX;
+		iBest_index = 0;
+		for (iK_index = 0; iK_index < iK_count; iK_index++) {
+			fSum_of_squares = 0;
+			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+				fDifference = pfPoint[iAttribute_index] - vvfMeans[iK_index][iAttribute_index];
+				fSum_of_squares += fDifference * fDifference;
+			} // for
+			if (fSum_of_squares < fBest_squared_difference) {
+				fBest_squared_difference = fSum_of_squares;
+				iBest_index = iK_index;
+			} // if
+		} // for
+		vullCounts[iBest_index]++;
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++)
+			vfSums[(size_t)iBest_index * iAttribute_ct + iAttribute_index] += pfPoint[iAttribute_index];
+	} // for
+
+	for (iK_index = 0; iK_index < iK_count; iK_index++) {
+		if (vullCounts[iK_index] == 0) continue; // a repeated mean keeps its place
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++)
+			vvfMeans[iK_index][iAttribute_index] = vfSums[(size_t)iK_index * iAttribute_ct + iAttribute_index] / (float)vullCounts[iK_index];
+	} // for
+
+	return;
+} // Cluster_set::Online_seed_means
+
+//***********************************************************************
+void Cluster_set::Online_respawn_cluster(int iK_index, const vector<float>& vfReservoir, unsigned uReservoir_ct){
+	// Moves a cluster to a reservoir instance chosen k-means++ style,
+	// weighted by the squared distance to the nearest other mean.
+
+	// local variables
+	vector<float> vfDistance(uReservoir_ct);
+	unsigned uIndex;
+	int iOther_index, iAttribute_index;
+	float fDifference, fSum_of_squares;
+	float fTotalDistance = 0;
+	float fRandomDistance;
+	const float* pfPoint;
+
+	for (uIndex = 0; uIndex < uReservoir_ct; uIndex++) {
+		pfPoint = vfReservoir.data() + (size_t)uIndex * iAttribute_ct;
+		vfDistance[uIndex] = FLT_MAX;
+		for (iOther_index = 0; iOther_index < iK_count; iOther_index++) {
+			if (iOther_index == iK_index) continue;
+			fSum_of_squares = 0;
+			for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+				fDifference = pfPoint[iAttribute_index] - vvfMeans[iOther_index][iAttribute_index];
+				fSum_of_squares += fDifference * fDifference;
+			} // for
+			if (fSum_of_squares < vfDistance[uIndex]) vfDistance[uIndex] = fSum_of_squares;
+		} // for
+		if (iK_count == 1) vfDistance[uIndex] = 1; // no other means - uniform choice
+		fTotalDistance += vfDistance[uIndex];
+	} // for
+
+	// every sampled instance sits on another mean, keep the cluster where it is
+	if (fTotalDistance <= 0) return;
+
+	fRandomDistance = uniform_real_distribution<float>(0, fTotalDistance)(mtRandom);
+	for (uIndex = 0; uIndex < uReservoir_ct; uIndex++) {
+		fRandomDistance -= vfDistance[uIndex];
+		if (fRandomDistance <= 0 || uIndex == uReservoir_ct - 1) {
+			pfPoint = vfReservoir.data() + (size_t)uIndex * iAttribute_ct;
+			vvfMeans[iK_index].assign(pfPoint, pfPoint + iAttribute_ct);
+			break;
+		} // if
+	} // for
+} // Cluster_set::Online_respawn_cluster
+
+//***********************************************************************
+void Cluster_set::Write_online_snapshot(ostream& strResults_out_stream, unsigned long long ullPoints, const vector<unsigned long long>& vullCounts){
+
+	// local variables
+	int iCluster_index, iAttribute_index;
+
+	strResults_out_stream << "Snapshot after " << ullPoints << " instances\n";
+
+	// same header format as the batch results
+	for (iCluster_index = 0; iCluster_index < iK_count; iCluster_index++){
+		strResults_out_stream << "Cluster #" << iCluster_index + 1 << " with mean ";
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+			strResults_out_stream << vvfMeans[iCluster_index][iAttribute_index] << " ";
+		} // for
+		strResults_out_stream << "and member count " << vullCounts[iCluster_index] << "\n";
+	} // for
+
+	// output CR/LF, flushed so readers of a FIFO see the snapshot
+	strResults_out_stream << "\n";
+	strResults_out_stream.flush();
+
+	return;
+} // Cluster_set::Write_online_snapshot
+
+//***********************************************************************
@@ -0,0 +1,518 @@
+//***********************************************************************
+// k-means-server.cpp
+//
+//   this is the server mode of the K-means classification algorithm.
+//   one long running process accepts control files over a socket and from
+//   a watched directory and runs them as jobs on a shared pool of threads.
+//   recently used input data sets are kept parsed in memory, so jobs that
+//   read the same file do not read it again
+//
+// INVOKE APPLICATION USING: k-means++ <control file name>
+//   with #server 1 and #server-address or #server-watch-directory in the
+//   control file
+//
+// INPUTS: (from socket or directory)
+//        <control file name> - one per line on a connection to #server-address
+//        <control file> - any file placed in #server-watch-directory. it is
+//             renamed to <name>.running when taken and <name>.done when finished,
+//             or <name>.failed if the job failed
+//
+// OUTPUTS:
+//        each job writes its own output file as usual. when a job finishes a
+//             line with its queue and execution latency, and the error if it
+//             failed, is printed and sent back on the connection the control
+//             file came from
+//
+//***********************************************************************
+//  WARNING: relative file names in job control files are relative to the
+//           server's working directory. POSIX only
+//
+//***********************************************************************
+// Copyright 2014 Isaac Brodsky
+//
+//***********************************************************************
+
+#include "k-means-multi.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <list>
+#include <deque>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+//***********************************************************************
+// class Cached_dataset declaration
+// A parsed input data set, shared by the jobs that read it.
+//***********************************************************************
+class Cached_dataset {
+
+public:
+	// public class variables
+	vector<Cluster_instance> vclInstances;
+	vector<string> vsLabels;
+	unordered_map<string, uint32_t> umLabel_ids;
+	int iAttribute_ct;
+	size_t szBytes; // estimated memory use
+
+}; // class Cached_dataset
+
+typedef shared_ptr<const Cached_dataset> Dataset_ptr;
+
+//***********************************************************************
+// class Dataset_cache declaration
+// Data sets by file name, evicted least recently used first once they
+// use more than the memory cap.
+//***********************************************************************
+class Dataset_cache {
+
+	// private class variables
+	class Cache_entry {
+	public:
+		string sVersion; // modification time and size of the file
+		shared_future<Dataset_ptr> sfData;
+		size_t szBytes; // 0 while the data set is being read
+		unsigned long long ullLoad_id;
+		list<string>::iterator itRecent;
+	};
+	mutex mxCache;
+	size_t szMax_bytes;
+	size_t szCached_bytes;
+	unsigned long long ullLoad_ct;
+	unordered_map<string, Cache_entry> umEntries;
+	list<string> lsRecent; // keys, most recently used first
+
+	// private methods
+	void Remove(unordered_map<string, Cache_entry>::iterator itEntry);
+	void Evict(void);
+
+public:
+	// public methods
+	Dataset_cache(size_t szMax); // constructor
+	Dataset_ptr Find(const string& sKey, const string& sVersion, function<Dataset_ptr(void)> fnLoad, bool& bHit);
+
+}; // class Dataset_cache
+
+//***********************************************************************
+// class Server_connection declaration
+// A client connection, closed once its last job has replied.
+//***********************************************************************
+class Server_connection {
+
+public:
+	// public class variables
+	int iFd;
+	mutex mxSend;
+
+	// public methods
+	Server_connection(int iConnection_fd) { iFd = iConnection_fd; }
+	~Server_connection() { close(iFd); }
+
+}; // class Server_connection
+
+//***********************************************************************
+// class Server_job declaration
+// A control file waiting for, or running on, the server's threads.
+//***********************************************************************
+class Server_job {
+
+public:
+	// public class variables
+	unsigned long long ullId;
+	string sName;
+	unique_ptr<Cluster_set> pclJob;
+	int iThreads; // threads the job holds while it runs
+	chrono::steady_clock::time_point tpQueued;
+	shared_ptr<Server_connection> pscReply; // null for watched directory jobs
+	string sRunning_file, sDone_file, sFailed_file; // set for watched directory jobs
+
+}; // class Server_job
+
+//***********************************************************************
+// class Dataset_cache method declarations
+//***********************************************************************
+Dataset_cache::Dataset_cache(size_t szMax){
+
+	szMax_bytes = szMax;
+	szCached_bytes = 0;
+	ullLoad_ct = 0;
+
+	return;
+} // Dataset_cache::Dataset_cache
+
+//***********************************************************************
+// Returns the data set, reading it with fnLoad if it is not cached. Jobs
+// that ask for a data set while it is being read wait for that read.
+Dataset_ptr Dataset_cache::Find(const string& sKey, const string& sVersion, function<Dataset_ptr(void)> fnLoad, bool& bHit){
+
+	// local variables
+	unique_lock<mutex> lkCache(mxCache);
+	unordered_map<string, Cache_entry>::iterator itEntry;
+	shared_future<Dataset_ptr> sfData;
+	promise<Dataset_ptr> prData;
+	Cache_entry ceNew;
+	unsigned long long ullLoad_id;
+	Dataset_ptr pcdData;
+
+	itEntry = umEntries.find(sKey);
+	if (itEntry != umEntries.end() && itEntry->second.sVersion == sVersion) {
+		lsRecent.splice(lsRecent.begin(), lsRecent, itEntry->second.itRecent);
+		sfData = itEntry->second.sfData;
+		lkCache.unlock();
+
+		bHit = true;
+		return sfData.get();
+	} // if
+
+	// never read, or the file changed since
+	if (itEntry != umEntries.end()) Remove(itEntry);
+
+	ullLoad_id = ++ullLoad_ct;
+	ceNew.sVersion = sVersion;
+	ceNew.sfData = prData.get_future().share();
+	ceNew.szBytes = 0;
+	ceNew.ullLoad_id = ullLoad_id;
+	lsRecent.push_front(sKey);
+	ceNew.itRecent = lsRecent.begin();
+	umEntries[sKey] = ceNew;
+	lkCache.unlock();
+
+	bHit = false;
+	pcdData = fnLoad();
+
+	lkCache.lock();
+	itEntry = umEntries.find(sKey);
+	// the entry may have been replaced by a newer version while reading
+	if (itEntry != umEntries.end() && itEntry->second.ullLoad_id == ullLoad_id) {
+		if (!pcdData || pcdData->szBytes > szMax_bytes) {
+			// failed, or too large to keep
+			Remove(itEntry);
+		}
+		else {
+			itEntry->second.szBytes = pcdData->szBytes;
+			szCached_bytes += pcdData->szBytes;
+			Evict();
+		} // if
+	} // if
+	lkCache.unlock();
+
+	prData.set_value(pcdData);
+
+	return pcdData;
+} // Dataset_cache::Find
+
+//***********************************************************************
+void Dataset_cache::Remove(unordered_map<string, Cache_entry>::iterator itEntry){
+
+	szCached_bytes -= itEntry->second.szBytes;
+	lsRecent.erase(itEntry->second.itRecent);
+	umEntries.erase(itEntry);
+
+	return;
+} // Dataset_cache::Remove
+
+//***********************************************************************
+void Dataset_cache::Evict(void){
+	// Drops the least recently used data sets until the rest fit. Jobs
+	// still using a dropped data set keep it until they finish.
+
+	// local variables
+	list<string>::iterator itKey = lsRecent.end();
+	unordered_map<string, Cache_entry>::iterator itEntry;
+
+	while (szCached_bytes > szMax_bytes && itKey != lsRecent.begin()) {
+		--itKey;
+		itEntry = umEntries.find(*itKey);
+		if (itEntry->second.szBytes == 0) continue; // still being read
+
+		++itKey; // the next key stays valid when this one is erased
+		Remove(itEntry);
+	} // while
+
+	return;
+} // Dataset_cache::Evict
+
+//***********************************************************************
+// Returns true if sText ends with sSuffix
+static bool Ends_with(const string& sText, const string& sSuffix){
+
+	return sText.size() >= sSuffix.size()
+		&& sText.compare(sText.size() - sSuffix.size(), sSuffix.size(), sSuffix) == 0;
+} // Ends_with
+
+//***********************************************************************
+// class Cluster_set server method declarations
+//***********************************************************************
+// Returns true on success
+bool Cluster_set::Read_cached_input_data(void){
+
+	// local variables
+	struct stat stFile;
+	char* pcPath;
+	string sKey, sVersion;
+	bool bHit;
+	Dataset_ptr pcdData;
+
+	if (stat(sIn_file.c_str(), &stFile) != 0) {
+		sError = "Error reading " + sIn_file;
+		cout << sError << endl << endl;
+		return false;
+	} // if
+
+	// the same file under different names is one entry. labels are part of
+	// the key since they change how each line is read
+	pcPath = realpath(sIn_file.c_str(), NULL);
+	sKey = pcPath != NULL ? pcPath : sIn_file;
+	free(pcPath);
+	sKey += bUseLabels ? " labels" : " no-labels";
+	sVersion = to_string((long long)stFile.st_mtim.tv_sec) + "." + to_string((long long)stFile.st_mtim.tv_nsec)
+		+ " " + to_string((long long)stFile.st_size);
+
+	pcdData = pclDataset_cache->Find(sKey, sVersion, [this]() {
+		Cluster_set clLoader;
+		shared_ptr<Cached_dataset> pcdLoaded;
+
+		clLoader.sIn_file = sIn_file;
+		clLoader.bUseLabels = bUseLabels;
+		if (!clLoader.Read_input_data()) return Dataset_ptr();
+
+		pcdLoaded = make_shared<Cached_dataset>();
+		pcdLoaded->vclInstances.swap(clLoader.vclInput_data);
+		pcdLoaded->vsLabels.swap(clLoader.vsLabels);
+		pcdLoaded->umLabel_ids.swap(clLoader.umLabel_ids);
+		pcdLoaded->iAttribute_ct = clLoader.iAttribute_ct;
+		pcdLoaded->szBytes = pcdLoaded->vclInstances.size()
+			* (sizeof(Cluster_instance) + pcdLoaded->iAttribute_ct * sizeof(float));
+		for (size_t szLabel_index = 0; szLabel_index < pcdLoaded->vsLabels.size(); szLabel_index++)
+			pcdLoaded->szBytes += 2 * (sizeof(string) + pcdLoaded->vsLabels[szLabel_index].size());
+		return Dataset_ptr(pcdLoaded); }, bHit);
+
+	if (!pcdData) return false;
+
+	// each job clusters its own copy of the instances
+	vclInput_data = pcdData->vclInstances;
+	vsLabels = pcdData->vsLabels;
+	umLabel_ids = pcdData->umLabel_ids;
+	iAttribute_ct = pcdData->iAttribute_ct;
+	sCache_status = bHit ? "hit" : "miss";
+
+	szInstance_ct = vclInput_data.size();
+	Allocate_means();
+
+	return true;
+} // Cluster_set::Read_cached_input_data
+
+//***********************************************************************
+void Cluster_set::Execute_server(void){
+
+	// local variables
+	int iListen_fd = -1;
+	int iFree_threads;
+	unsigned long long ullJob_ct = 0;
+	mutex mxQueue;
+	condition_variable cvQueue;
+	deque<Server_job> dqJobs;
+	unique_ptr<Dataset_cache> pdcCache;
+	function<void(const string&, const string&, shared_ptr<Server_connection>, const string&)> fnSubmit;
+	function<void(Server_job&, const string&)> fnReply;
+
+	if (sServer_address.empty() && sServer_watch_directory.empty()) {
+		cout << "The server needs a #server-address or a #server-watch-directory." << endl << endl;
+		return;
+	} // if
+
+	if (iServer_threads < 1) iServer_threads = max(1, (int)thread::hardware_concurrency());
+	iFree_threads = iServer_threads;
+	if (iServer_cache_mb > 0) pdcCache.reset(new Dataset_cache((size_t)iServer_cache_mb << 20));
+
+	if (!sServer_address.empty()) {
+		iListen_fd = Socket_open(sServer_address, true);
+		if (iListen_fd < 0) {
+			cout << "Error listening on " << sServer_address << endl << endl;
+			return;
+		} // if
+	} // if
+
+	cout << "Server running " << iServer_threads << " threads with a " << iServer_cache_mb << " MB dataset cache";
+	if (iListen_fd >= 0) cout << ", listening on " << sServer_address;
+	if (!sServer_watch_directory.empty()) cout << ", watching " << sServer_watch_directory;
+	cout << endl;
+
+	// prints a line about the job and sends it to the job's client
+	fnReply = [](Server_job& sjJob, const string& sMessage) {
+		string sLine = "Job " + to_string(sjJob.ullId) + " " + sjJob.sName + " " + sMessage + "\n";
+
+		cout << sLine << flush;
+		if (sjJob.pscReply) {
+			lock_guard<mutex> lkSend(sjJob.pscReply->mxSend);
+			Send_all(sjJob.pscReply->iFd, sLine.data(), sLine.size());
+		} // if
+	};
+
+	// reads a job's control file and queues the job
+	fnSubmit = [&](const string& sName, const string& sControl_file, shared_ptr<Server_connection> pscReply, const string& sDone_file) {
+		Server_job sjJob;
+		ifstream strControl_stream(sControl_file.c_str());
+
+		sjJob.sName = sName;
+		sjJob.pscReply = pscReply;
+		sjJob.tpQueued = chrono::steady_clock::now();
+		{
+			lock_guard<mutex> lkQueue(mxQueue);
+			sjJob.ullId = ++ullJob_ct;
+		}
+
+		if (!strControl_stream.is_open()) {
+			fnReply(sjJob, "error reading the control file");
+			return;
+		} // if
+		strControl_stream.close();
+
+		sjJob.pclJob.reset(new Cluster_set);
+		sjJob.pclJob->Read_control_data(sControl_file);
+		sjJob.pclJob->bServer = false; // a job can't start another server
+		sjJob.pclJob->pclDataset_cache = pdcCache.get();
+		sjJob.iThreads = max(1, max(sjJob.pclJob->iNumThreads, sjJob.pclJob->iNumPlusPlusThreads));
+		if (sjJob.iThreads > iServer_threads) {
+			// a job never runs more threads than the pool has
+			cout << "Job " << sjJob.ullId << " " << sName << " asks for " << sjJob.iThreads
+				<< " threads, running it with " << iServer_threads << endl;
+			sjJob.iThreads = iServer_threads;
+			sjJob.pclJob->iNumThreads = min(sjJob.pclJob->iNumThreads, iServer_threads);
+			sjJob.pclJob->iNumPlusPlusThreads = min(sjJob.pclJob->iNumPlusPlusThreads, iServer_threads);
+		} // if
+		if (!sDone_file.empty()) {
+			sjJob.sRunning_file = sControl_file;
+			sjJob.sDone_file = sDone_file;
+			sjJob.sFailed_file = sName + ".failed";
+		} // if
+
+		{
+			lock_guard<mutex> lkQueue(mxQueue);
+			dqJobs.push_back(move(sjJob));
+		}
+		cvQueue.notify_all();
+	};
+
+	// each connection sends control file names, one per line
+	if (iListen_fd >= 0) {
+		thread([&, iListen_fd]() {
+			int iFd;
+
+			while (true) {
+				iFd = accept(iListen_fd, NULL, NULL);
+				if (iFd < 0) continue;
+
+				thread([&, iFd]() {
+					shared_ptr<Server_connection> pscConnection(new Server_connection(iFd));
+					char acBuffer[4096];
+					ssize_t ssReceived;
+					string sPending, sLine;
+					size_t szEnd;
+
+					while (true) {
+						ssReceived = recv(iFd, acBuffer, sizeof(acBuffer), 0);
+						if (ssReceived > 0) sPending.append(acBuffer, ssReceived);
+						else sPending += '\n'; // the client is done, take any unterminated name
+
+						while ((szEnd = sPending.find('\n')) != string::npos) {
+							sLine = sPending.substr(0, szEnd);
+							sPending.erase(0, szEnd + 1);
+							sLine.erase(sLine.find_last_not_of(" \t\r") + 1);
+							sLine.erase(0, sLine.find_first_not_of(" \t"));
+							if (!sLine.empty()) fnSubmit(sLine, sLine, pscConnection, "");
+						} // while
+						if (ssReceived <= 0) break;
+					} // while
+				}).detach();
+			} // while
+		}).detach();
+	} // if
+
+	// every file placed in the directory is a job
+	if (!sServer_watch_directory.empty()) {
+		thread([&]() {
+			DIR* pdDirectory;
+			struct dirent* pdeEntry;
+			struct stat stFile;
+			vector<string> vsNames;
+			string sPath;
+
+			while (true) {
+				vsNames.clear();
+				pdDirectory = opendir(sServer_watch_directory.c_str());
+				if (pdDirectory != NULL) {
+					while ((pdeEntry = readdir(pdDirectory)) != NULL) {
+						sPath = pdeEntry->d_name;
+						if (sPath[0] == '.' || Ends_with(sPath, ".running") || Ends_with(sPath, ".done")
+							|| Ends_with(sPath, ".failed")) continue;
+						vsNames.push_back(sPath);
+					} // while
+					closedir(pdDirectory);
+				} // if
+
+				// oldest names first when several arrive together
+				sort(vsNames.begin(), vsNames.end());
+				for (size_t szName_index = 0; szName_index < vsNames.size(); szName_index++) {
+					sPath = sServer_watch_directory + "/" + vsNames[szName_index];
+					if (stat(sPath.c_str(), &stFile) != 0 || !S_ISREG(stFile.st_mode)) continue;
+					// renaming claims the file so it is only run once
+					if (rename(sPath.c_str(), (sPath + ".running").c_str()) != 0) continue;
+					fnSubmit(sPath, sPath + ".running", shared_ptr<Server_connection>(), sPath + ".done");
+				} // for
+
+				this_thread::sleep_for(chrono::milliseconds(iServer_poll_ms));
+			} // while
+		}).detach();
+	} // if
+
+	// start jobs in arrival order as soon as there are enough free threads
+	while (true) {
+		unique_lock<mutex> lkQueue(mxQueue);
+		cvQueue.wait(lkQueue, [&]() { return !dqJobs.empty() && dqJobs.front().iThreads <= iFree_threads; });
+		Server_job sjNext(move(dqJobs.front()));
+		dqJobs.pop_front();
+		iFree_threads -= sjNext.iThreads;
+		lkQueue.unlock();
+
+		thread([&](Server_job sjJob) {
+			chrono::steady_clock::time_point tpStart, tpEnd;
+			ostringstream strMessage;
+
+			tpStart = chrono::steady_clock::now();
+			sjJob.pclJob->Execute_clustering();
+			tpEnd = chrono::steady_clock::now();
+
+			{
+				lock_guard<mutex> lkQueue(mxQueue);
+				iFree_threads += sjJob.iThreads;
+			}
+			cvQueue.notify_all();
+
+			// a failed job is left as <name>.failed so it is not taken for a result
+			if (!sjJob.sDone_file.empty()) {
+				rename(sjJob.sRunning_file.c_str(), sjJob.pclJob->sError.empty() ? sjJob.sDone_file.c_str()
+					: sjJob.sFailed_file.c_str());
+			} // if
+
+			strMessage << "queued " << chrono::duration<double, milli>(tpStart - sjJob.tpQueued).count()
+				<< " ms, ran " << chrono::duration<double, milli>(tpEnd - tpStart).count() << " ms";
+			if (!sjJob.pclJob->sCache_status.empty())
+				strMessage << ", dataset cache " << sjJob.pclJob->sCache_status;
+			if (!sjJob.pclJob->sError.empty())
+				strMessage << ", failed: " << sjJob.pclJob->sError;
+			fnReply(sjJob, strMessage.str()); }, move(sjNext)).detach();
+	} // while
+
+} // Cluster_set::Execute_server
+
+//***********************************************************************
@@ -0,0 +1,419 @@
+//***********************************************************************
+// k-means-sparse.cpp
+//
+//   this is the sparse input mode of the K-means classification algorithm,
+//   for high dimensional data with few nonzero attributes per instance
+//   (e.g. TF-IDF text features). the instances are stored in compressed
+//   sparse row (CSR) form and only the means are dense, so the work per
+//   instance scales with its nonzero count instead of the attribute count
+//
+// INVOKE APPLICATION USING: k-means++ <control file name>
+//   with #sparse-input 1 in the control file
+//
+// INPUTS: (from disk file)
+//        <datafile.dat> - attribute count on the first line, then one
+//             instance per line as space delimited index:value pairs
+//             (indexes from 0), followed by the classification if
+//             #use-labels is 1
+//
+// OUTPUTS: (to disk file)
+//        <output_filename> - the usual results, with the means and the
+//             instances written as index:value pairs of their nonzeros
+//
+//***********************************************************************
+// Copyright 2014 Isaac Brodsky
+//
+//***********************************************************************
+
+#include "k-means-multi.h"
+#include <fstream>
+#include <future>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+//***********************************************************************
+// class Cluster_set sparse method declarations
+//***********************************************************************
+// Returns true on success
+bool Cluster_set::Read_sparse_input_data(void){
+
+	// local variables
+	ifstream strInput_stream;
+	string sLine, sLabel;
+	const char* pcCursor;
+	char* pcEnd;
+	unsigned long ulColumn;
+	float fValue, fNorm;
+	uint32_t uBlank_label;
+	unsigned long long ullRead_ct = 0;
+	Cluster_instance clInput_instance;
+
+	strInput_stream.open(sIn_file.c_str());
+	if (!strInput_stream.is_open()) {
+		sError = "Error reading " + sIn_file;
+		cout << sError << endl << endl;
+		return false;
+	}
+
+	strInput_stream >> iAttribute_ct;
+	if (strInput_stream.fail() || iAttribute_ct < 1) {
+		sError = "Error reading the attribute count from " + sIn_file;
+		cout << sError << endl << endl;
+		return false;
+	}
+	getline(strInput_stream, sLine); // skip the rest of the header line
+
+	uBlank_label = Intern_label("BLANK");
+	vszRow_start.assign(1, 0);
+	vuColumn.clear();
+	vfValue.clear();
+	vfRow_norm.clear();
+
+	while (getline(strInput_stream, sLine)) {
+
+		// parse index:value pairs up to the classification
+		pcCursor = sLine.c_str();
+		fNorm = 0;
+		sLabel.clear();
+		while (true) {
+			while (*pcCursor == ' ' || *pcCursor == '\t' || *pcCursor == '\r') pcCursor++;
+			if (*pcCursor == '\0') break;
+
+			ulColumn = strtoul(pcCursor, &pcEnd, 10);
+			if (pcEnd == pcCursor || *pcEnd != ':') {
+				// not a pair - the classification
+				sLabel = pcCursor;
+				sLabel = sLabel.substr(0, sLabel.find_first_of(" \t\r"));
+				break;
+			} // if
+			pcCursor = pcEnd + 1;
+			fValue = strtof(pcCursor, &pcEnd);
+			pcCursor = pcEnd;
+
+			if (ulColumn >= (unsigned long)iAttribute_ct) {
+				cout << "Attribute index " << ulColumn << " out of range in " << sIn_file << endl;
+				continue;
+			} // if
+			if (fValue == 0) continue;
+
+			vuColumn.push_back((uint32_t)ulColumn);
+			vfValue.push_back(fValue);
+			fNorm += fValue * fValue;
+		} // while
+
+		// skip blank lines without keeping partial rows
+		if (vuColumn.size() == vszRow_start.back() && sLabel.empty()) continue;
+
+		// keep the instance if it is in this process's shard
+		if (ullRead_ct++ % iShard_count != (unsigned long long)iShard_index) {
+			vuColumn.resize(vszRow_start.back());
+			vfValue.resize(vszRow_start.back());
+			continue;
+		} // if
+
+		vszRow_start.push_back(vuColumn.size());
+		vfRow_norm.push_back(fNorm);
+
+		// the label and assignment are kept per instance, without attributes
+		clInput_instance.uLabel = (bUseLabels && !sLabel.empty()) ? Intern_label(sLabel) : uBlank_label;
+		vclInput_data.push_back(clInput_instance);
+	} // while
+
+	strInput_stream.close();
+
+	szInstance_ct = vclInput_data.size();
+	// only the seeding uses one vector per mean, there are no old means
+	vvfMeans.assign(iK_count, vector<float>(iAttribute_ct));
+	vfDrift.assign(iK_count, 0);
+
+	return true;
+} // Cluster_set::Read_sparse_input_data
+
+//***********************************************************************
+void Cluster_set::Execute_sparse_clustering(void){
+
+	// local variables
+	bool bNot_done = true;
+	int iK_index, iAttribute_index, iThread_index;
+	size_t szRow, szNonzero, szSum_index;
+	float fDifference, fResult_difference;
+	vector<float> vfMeans_by_attribute, vfMean_norms, vfSums;
+	vector<unsigned> vuCounts;
+	chrono::steady_clock::time_point tpSeeding_start;
+
+	if (!Read_sparse_input_data()) return;
+
+	if (szInstance_ct < (size_t)iK_count) {
+		sError = "Fewer instances than clusters.";
+		cout << sError << endl << endl;
+		return;
+	} // if
+
+	// the time budget starts once the data is loaded
+	tpClustering_start = chrono::steady_clock::now();
+
+	// seed the means
+	tpSeeding_start = chrono::steady_clock::now();
+	if (bUsePlusPlus) {
+		Sparse_plus_plus();
+	}
+	else { // Use the first k instances.
+		for (iK_index = 0; iK_index < iK_count; iK_index++){
+			for (szNonzero = vszRow_start[iK_index]; szNonzero < vszRow_start[iK_index + 1]; szNonzero++)
+				vvfMeans[iK_index][vuColumn[szNonzero]] = vfValue[szNonzero];
+		} // for
+	} // if
+	dSeeding_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - tpSeeding_start).count();
+
+	// lay the means out by attribute, so each nonzero of an instance reads
+	// the k mean values for its attribute together. the means and the sums
+	// are the only k by attribute count arrays kept while clustering
+	vfMeans_by_attribute.resize((size_t)iAttribute_ct * iK_count);
+	for (iK_index = 0; iK_index < iK_count; iK_index++){
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++)
+			vfMeans_by_attribute[(size_t)iAttribute_index * iK_count + iK_index] = vvfMeans[iK_index][iAttribute_index];
+	} // for
+	vector< vector<float> >().swap(vvfMeans);
+	vfMean_norms.resize(iK_count);
+	vfSums.resize((size_t)iAttribute_ct * iK_count);
+	vuCounts.resize(iK_count);
+
+	// loop until we are done clustering, as in Run_clustering
+	while (bNot_done){
+
+		fill(vfMean_norms.begin(), vfMean_norms.end(), 0.0f);
+		for (szSum_index = 0; szSum_index < vfMeans_by_attribute.size(); szSum_index += iK_count){
+			for (iK_index = 0; iK_index < iK_count; iK_index++)
+				vfMean_norms[iK_index] += vfMeans_by_attribute[szSum_index + iK_index] * vfMeans_by_attribute[szSum_index + iK_index];
+		} // for
+
+		// cluster the input data using the k means values
+		if (iNumThreads == 1)
+		{
+			//Don't bother creating more threads.
+			uReassigned_ct = Cluster_sparse_data_process(0, szInstance_ct, vfMeans_by_attribute, vfMean_norms);
+		}
+		else
+		{
+			// local variables
+			unsigned uPerThread;
+			unsigned uDataStart;
+			vector<future<unsigned>> vtThreads;
+
+			uDataStart = 0;
+			uPerThread = szInstance_ct / iNumThreads;
+
+			//Split the dataset into parts and launch as individual
+			//threads.
+			for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+			{
+				//Force the last thread to take remaining data
+				if (iThread_index == iNumThreads - 1)
+				{
+					uPerThread = szInstance_ct - uDataStart;
+				}
+
+				vtThreads.push_back(async(launch::async, [=, &vfMeans_by_attribute, &vfMean_norms](unsigned uStart, unsigned uLength) {
+					return Cluster_sparse_data_process(uStart, uLength, vfMeans_by_attribute, vfMean_norms); }, uDataStart, uPerThread));
+
+				uDataStart += uPerThread;
+			} // Launch all threads
+
+			//Wait for all threads to complete.
+			uReassigned_ct = 0;
+			for (iThread_index = 0; iThread_index < iNumThreads; iThread_index++)
+			{
+				uReassigned_ct += vtThreads[iThread_index].get();
+			} // Wait for all threads
+		}
+
+		// scatter-add each instance's nonzeros into its cluster's sums,
+		// laid out by attribute like the means
+		fill(vfSums.begin(), vfSums.end(), 0.0f);
+		fill(vuCounts.begin(), vuCounts.end(), 0);
+		for (szRow = 0; szRow < szInstance_ct; szRow++){
+			iK_index = vclInput_data[szRow].iCluster;
+			for (szNonzero = vszRow_start[szRow]; szNonzero < vszRow_start[szRow + 1]; szNonzero++)
+				vfSums[(size_t)vuColumn[szNonzero] * iK_count + iK_index] += vfValue[szNonzero];
+			vuCounts[iK_index]++;
+		} // for
+		Finalize_cluster_means(vfSums, vuCounts, true);
+
+		// how far the means moved, as Compare_mean_values measures it
+		fResult_difference = 0;
+		fill(vfDrift.begin(), vfDrift.end(), 0.0f);
+		for (szSum_index = 0; szSum_index < vfSums.size(); szSum_index++){
+			fDifference = vfSums[szSum_index] - vfMeans_by_attribute[szSum_index];
+			vfDrift[szSum_index % iK_count] += fDifference * fDifference;
+			fResult_difference += fabs(fDifference);
+		} // for
+		fMax_drift = 0;
+		for (iK_index = 0; iK_index < iK_count; iK_index++){
+			vfDrift[iK_index] = sqrt(vfDrift[iK_index]);
+			if (vfDrift[iK_index] > fMax_drift) fMax_drift = vfDrift[iK_index];
+		} // for
+		vfMeans_by_attribute.swap(vfSums);
+
+		bNot_done = Not_converged(fResult_difference);
+		iIteration++;
+		if (bNot_done && Budget_exhausted()) bNot_done = false;
+	} // while
+
+	// one vector per mean again for the output
+	vector<float>().swap(vfSums);
+	vvfMeans.assign(iK_count, vector<float>(iAttribute_ct));
+	for (iK_index = 0; iK_index < iK_count; iK_index++){
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++)
+			vvfMeans[iK_index][iAttribute_index] = vfMeans_by_attribute[(size_t)iAttribute_index * iK_count + iK_index];
+	} // for
+
+	if (bReport_stats) {
+		cout << "Seeding took " << dSeeding_ms << " ms, clustering took " << iIteration << " iterations" << endl;
+	} // if
+
+	Write_sparse_output_data();
+
+	return;
+} // Cluster_set::Execute_sparse_clustering
+
+//***********************************************************************
+// Returns the number of instances that changed cluster
+unsigned Cluster_set::Cluster_sparse_data_process(unsigned uIndex, unsigned uLength, const vector<float>& vfMeans_by_attribute, const vector<float>& vfMean_norms){
+	// Assigns each instance using ||x||^2 - 2 x.c + ||c||^2, where the dot
+	// products only visit the instance's nonzeros.
+
+	// local variables
+	unsigned uReassigned = 0;
+	unsigned uLast = uIndex + uLength;
+	vector<float> vfDot(iK_count);
+	float fDistance, fBest_distance;
+	int iK_index, iBest_index;
+	size_t szNonzero;
+
+	for (; uIndex < uLast; uIndex++) {
+		fill(vfDot.begin(), vfDot.end(), 0.0f);
+		for (szNonzero = vszRow_start[uIndex]; szNonzero < vszRow_start[uIndex + 1]; szNonzero++) {
+			const float* pfMeans = &vfMeans_by_attribute[(size_t)vuColumn[szNonzero] * iK_count];
+			for (iK_index = 0; iK_index < iK_count; iK_index++)
+				vfDot[iK_index] += vfValue[szNonzero] * pfMeans[iK_index];
+		} // for
+
+		fBest_distance = FLT_MAX;
+		iBest_index = 0;
+		for (iK_index = 0; iK_index < iK_count; iK_index++) {
+			fDistance = vfRow_norm[uIndex] - 2 * vfDot[iK_index] + vfMean_norms[iK_index];
+			if (fDistance < fBest_distance) {
+				fBest_distance = fDistance;
+				iBest_index = iK_index;
+			} // if
+		} // for
+
+		if (vclInput_data[uIndex].iCluster != iBest_index) uReassigned++;
+		vclInput_data[uIndex].iCluster = iBest_index;
+	} // for
+
+	return uReassigned;
+} // Cluster_set::Cluster_sparse_data_process
+
+//***********************************************************************
+void Cluster_set::Sparse_plus_plus(void) {
+	// Initializes using K-means++ as Initialize_plus_plus does, but keeps
+	// each instance's distance to its nearest mean so each new mean only
+	// needs one sparse dot product per instance.
+
+	// local variables
+	vector<float> vfDistance(szInstance_ct, FLT_MAX);
+	size_t szRow, szNonzero, szSelected_row;
+	int iSelectedPoints;
+	float fDot, fMean_norm, fDistance;
+	double dTotalDistance, dRandomDistance;
+
+	// Select the first data instance as the initial mean
+	szSelected_row = 0;
+	for (iSelectedPoints = 0; iSelectedPoints < iK_count; iSelectedPoints++) {
+		if (Seeding_out_of_time(iSelectedPoints)) break;
+		vector<float>& vfMean = vvfMeans[iSelectedPoints];
+		for (szNonzero = vszRow_start[szSelected_row]; szNonzero < vszRow_start[szSelected_row + 1]; szNonzero++)
+			vfMean[vuColumn[szNonzero]] = vfValue[szNonzero];
+		if (iSelectedPoints == iK_count - 1) break;
+
+		// update the distances with the new mean
+		fMean_norm = vfRow_norm[szSelected_row];
+		dTotalDistance = 0;
+		for (szRow = 0; szRow < szInstance_ct; szRow++) {
+			fDot = 0;
+			for (szNonzero = vszRow_start[szRow]; szNonzero < vszRow_start[szRow + 1]; szNonzero++)
+				fDot += vfValue[szNonzero] * vfMean[vuColumn[szNonzero]];
+			fDistance = max(0.0f, vfRow_norm[szRow] - 2 * fDot + fMean_norm);
+			if (fDistance < vfDistance[szRow]) vfDistance[szRow] = fDistance;
+			dTotalDistance += vfDistance[szRow];
+		} // for
+
+		// Choose the next mean in proportion to the squared distance
+		dRandomDistance = uniform_real_distribution<double>(0, dTotalDistance)(mtRandom);
+		for (szSelected_row = 0; szSelected_row < szInstance_ct - 1; szSelected_row++) {
+			dRandomDistance -= vfDistance[szSelected_row];
+			if (dRandomDistance <= 0 && vfDistance[szSelected_row] > 0) break;
+		} // for
+	} // for
+} // Cluster_set::Sparse_plus_plus
+
+//***********************************************************************
+void Cluster_set::Write_sparse_output_data(void){
+
+	// local variables
+	unsigned uInstance_index, uRow;
+	int iCluster_index, iAttribute_index;
+	size_t szNonzero;
+	vector< vector<unsigned> > vuThe_cluster_set(iK_count);
+
+	// declare an output stream
+	ofstream strResults_out_stream;
+
+	// Sort the cluster results
+	for (uInstance_index = 0; uInstance_index < vclInput_data.size(); uInstance_index++)
+	{
+		vuThe_cluster_set[vclInput_data[uInstance_index].iCluster].push_back(uInstance_index);
+	}
+
+	strResults_out_stream.open(sOut_file);
+	if (!strResults_out_stream.is_open()) {
+		sError = "Error writing " + sOut_file;
+		cout << sError << endl << endl;
+		return;
+	} // if
+
+	for (iCluster_index = 0; iCluster_index < iK_count; iCluster_index++){
+
+		// output a cluster header, with the mean's nonzeros
+		strResults_out_stream << "Cluster #" << iCluster_index + 1 << " with mean ";
+		for (iAttribute_index = 0; iAttribute_index < iAttribute_ct; iAttribute_index++){
+			if (vvfMeans[iCluster_index][iAttribute_index] != 0)
+				strResults_out_stream << iAttribute_index << ":" << vvfMeans[iCluster_index][iAttribute_index] << " ";
+		} // for
+		strResults_out_stream << "and member count "
+			<< vuThe_cluster_set[iCluster_index].size() << "\n";
+
+		// loop thru the cluster members, in the input format
+		for (uInstance_index = 0; uInstance_index < vuThe_cluster_set[iCluster_index].size(); uInstance_index++){
+			uRow = vuThe_cluster_set[iCluster_index][uInstance_index];
+			for (szNonzero = vszRow_start[uRow]; szNonzero < vszRow_start[uRow + 1]; szNonzero++)
+				strResults_out_stream << vuColumn[szNonzero] << ":" << vfValue[szNonzero] << " ";
+			strResults_out_stream << " " << vsLabels[vclInput_data[uRow].uLabel] << "\n";
+		} // for
+
+		// output CR/LF
+		strResults_out_stream << "\n";
+	} // for
+
+	if (bLabel_report) {
+		Write_label_report(strResults_out_stream);
+	} // if
+
+	strResults_out_stream.close();
+
+	return;
+} // Cluster_set::Write_sparse_output_data
+
+//***********************************************************************
@@ -15,13 +15,50 @@
 //
 //			   control labels: #k-count, #input-filename, #output-filename, #use-labels,
 //				 #tolerance, #plus-plus, #plus-plus-threads, #plus-plus-random-seed,
-//				 #num-threads, #EOF
+//				 #num-threads, #online, #online-learning-rate, #online-snapshot-interval,
+//				 #online-reservoir-size, #online-dead-after, #online-warmup, #label-report,
+//				 #reassign-tolerance, #max-iterations, #time-budget-ms, #drift-skip,
+//				 #numa, #distributed-role, #distributed-address, #distributed-workers,
+//				 #parallel-rounds, #parallel-oversampling, #afk-mc2, #afk-mc2-chain-length,
+//				 #report-stats, #hierarchical, #coarse-k-count, #hierarchical-refine,
+//				 #hierarchical-neighbours, #sparse-input, #server, #server-address,
+//				 #server-watch-directory, #server-threads, #server-cache-mb,
+//				 #server-poll-ms, #EOF
 //
 //             values: k value = integer, input datafile name = string,
 //				 output datafile name = string, use data labels = boolean (1, 0),
 //				 stopping tolerance value = float, use k-means++ = boolean (1, 0),
 //				 number of k-means++ threads = integer, random seed for k-means++ = integer,
-//				 number of threads = integer, eof = no value
+//				 number of threads = integer, use online mode = boolean (1, 0),
+//				 online learning rate = float (0 for count based),
+//				 points between snapshots = integer, reservoir sample size = integer,
+//				 points before an idle cluster is respawned = integer,
+//				 points the means are seeded from = integer (0 for 10 times k),
+//				 write a label histogram and purity report = boolean (1, 0),
+//				 stopping fraction of reassigned instances = float (negative to disable),
+//				 maximum iterations = integer (0 for no limit),
+//				 time budget in milliseconds = integer (0 for no limit),
+//				 skip stable instances using mean drift bounds = boolean (1, 0),
+//				 place data and threads by NUMA node = boolean (1, 0),
+//				 distributed role = string (coordinator, worker),
+//				 distributed address = string (host:port or unix:path),
+//				 number of distributed workers = integer,
+//				 k-means|| seeding rounds = integer,
+//				 k-means|| candidates per round as a multiple of k = float,
+//				 use AFK-MC2 approximate k-means++ seeding = boolean (1, 0),
+//				 AFK-MC2 markov chain length = integer,
+//				 print seeding time and final inertia = boolean (1, 0),
+//				 use two level k-means = boolean (1, 0),
+//				 number of coarse clusters = integer (0 for the square root of k),
+//				 global refinement iterations = integer,
+//				 coarse cells searched by the refinement = integer,
+//				 read index:value sparse input = boolean (1, 0),
+//				 run as a job server = boolean (1, 0),
+//				 server address = string (host:port or unix:path),
+//				 directory watched for control files = string,
+//				 threads shared by the server's jobs = integer (0 for one per cpu),
+//				 dataset cache size in megabytes = integer (0 to disable),
+//				 milliseconds between directory scans = integer, eof = no value
 //
 //        <datafile.dat> - classification set - filename specified in the control file
 //             attribute count - don't include the classification in